@@ -69,8 +69,15 @@ typedef enum {
 typedef struct NinState NinState;
 typedef void (*NINAUDIOCALLBACK)(void*, const float*);
 
+#define NIN_CREATE_LINE_CACHE   0x02
+
 #define NIN_AUDIO_SAMPLE_SIZE   1024
+#define NIN_AUDIO_BLOCK_MIN     64
 #define NIN_FRAME_SIZE          (256 * 240 * 4)
+#define NIN_FRAME_SIZE_RGB565   (256 * 240 * 2)
+#define NIN_FRAME_SIZE_YUV420   (256 * 240 * 3 / 2)
+#define NIN_FRAME_BUFFERS_MAX   8
+#define NIN_DIRTY_SIZE          (240 / 8)
 
 #define NIN_BUTTON_A        0x01
 #define NIN_BUTTON_B        0x02
@@ -88,6 +95,18 @@ typedef enum {
     NIN_REGION_DENDY    = 3
 } NinRegion;
 
+typedef enum {
+    NIN_PIXEL_FORMAT_RGBA8888   = 0,
+    NIN_PIXEL_FORMAT_BGRA8888   = 1,
+    NIN_PIXEL_FORMAT_RGB565     = 2,
+    NIN_PIXEL_FORMAT_YUV420     = 3
+} NinPixelFormat;
+
+typedef enum {
+    NIN_AUDIO_FORMAT_FLOAT  = 0,
+    NIN_AUDIO_FORMAT_INT16  = 1
+} NinAudioFormat;
+
 typedef enum {
     NIN_SYSTEM_NES      = 0,
     NIN_SYSTEM_FDS      = 1
@@ -109,13 +128,25 @@ typedef enum {
 typedef int32_t NinInt32;
 
 NIN_API NinError        ninCreateState(NinState** state, const char* path);
+NIN_API NinError        ninCreateStateEx(NinState** state, const char* path, uint32_t flags);
 NIN_API void            ninSetSaveFile(NinState* state, const char* path);
 NIN_API void            ninSyncSave(NinState* state);
 NIN_API void            ninDestroyState(NinState* state);
 NIN_API int             ninRunCycles(NinState* state, size_t cycles, size_t* cyc);
+NIN_API int             ninRunFrames(NinState* state, size_t frames, size_t* cyc);
 NIN_API const uint32_t* ninGetScreenBuffer(NinState* state);
+NIN_API void            ninSetFrameBuffers(NinState* state, void* const* buffers, size_t count);
+NIN_API void            ninSetPixelFormat(NinState* state, NinPixelFormat format);
+NIN_API void            ninSetVideoEnabled(NinState* state, int enabled);
+NIN_API void*           ninAcquireFrame(NinState* state);
+NIN_API void            ninReleaseFrame(NinState* state, void* frame);
+NIN_API uint64_t        ninGetFrameDirty(NinState* state, const void* frame, uint8_t* dirty);
 NIN_API void            ninSetInput(NinState* state, uint8_t input);
 NIN_API void            ninAudioSetFrequency(NinState* state, uint32_t frequency);
+NIN_API void            ninAudioSetRateAdjust(NinState* state, float ratio);
+NIN_API void            ninSetAudioEnabled(NinState* state, int enabled);
+NIN_API void            ninAudioSetBlockSize(NinState* state, size_t size);
+NIN_API size_t          ninAudioRead(NinState* state, void* dst, size_t count, NinAudioFormat format);
 NIN_API void            ninAudioSetCallback(NinState* state, NINAUDIOCALLBACK callback, void* arg);
 NIN_API void            ninLoadBiosFDS(NinState* state, const char* path);
 
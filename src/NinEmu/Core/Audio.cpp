@@ -33,6 +33,9 @@
 
 Audio::Audio(QObject* parent)
 : QObject(parent)
+, _playbackDrift(1.0)
+, _reportedOverruns(0)
+, _reportedUnderruns(0)
 {
     ALCint nativeFrequency;
 
@@ -46,6 +49,11 @@ Audio::Audio(QObject* parent)
     _buffers.resize(kBufferCount);
     alGenBuffers(kBufferCount, _buffers.data());
     alGenSources(1, &_source);
+
+    /* Drain the ring from here, the emulation thread never waits on us */
+    _timer = new QTimer(this);
+    connect(_timer, &QTimer::timeout, this, &Audio::feed);
+    _timer->start(kFeedInterval);
 }
 
 Audio::~Audio()
@@ -85,15 +93,54 @@ void Audio::reset()
         alSourceQueueBuffers(_source, 1, &buffer);
     }
 
+    /* The emulator is stopped while it resets, the ring has no writer */
+    _ring.clear();
     _playbackDrift = 1.0;
     alSourcePlay(_source);
 }
 
-void Audio::pushSamples(const float* samples)
+void Audio::feed()
 {
-    float tmp[NIN_AUDIO_SAMPLE_SIZE + 1];
+    float block[NIN_AUDIO_SAMPLE_SIZE];
     ALuint buffer;
     ALint attr;
+
+    /* Unqueue previous buffers */
+    alGetSourcei(_source, AL_BUFFERS_PROCESSED, &attr);
+    for (int i = 0; i < attr; ++i)
+    {
+        alSourceUnqueueBuffers(_source, 1, &buffer);
+        _buffers.push_back(buffer);
+    }
+
+    adjustDrift();
+
+    while (!_buffers.empty() && _ring.size() >= NIN_AUDIO_SAMPLE_SIZE)
+    {
+        _ring.read(block, NIN_AUDIO_SAMPLE_SIZE);
+        queueBlock(block);
+        emit samples(block);
+    }
+
+    /* The source stops by itself once it played everything we gave it */
+    alGetSourcei(_source, AL_SOURCE_STATE, &attr);
+    if (attr != AL_PLAYING)
+    {
+        alGetSourcei(_source, AL_BUFFERS_QUEUED, &attr);
+        if (attr)
+        {
+            _ring.underrun();
+            alSourcePlay(_source);
+        }
+    }
+
+    report();
+}
+
+void Audio::queueBlock(const float* samples)
+{
+    float tmp[NIN_AUDIO_SAMPLE_SIZE + 1];
+    ALuint buffer;
     ALsizei len;
 
     len = NIN_AUDIO_SAMPLE_SIZE;
@@ -113,35 +160,11 @@ void Audio::pushSamples(const float* samples)
         len--;
     }
 
-    /* Unqueue previous buffers */
-    alGetSourcei(_source, AL_BUFFERS_PROCESSED, &attr);
-    for (int i = 0; i < attr; ++i)
-    {
-        alSourceUnqueueBuffers(_source, 1, &buffer);
-        _buffers.push_back(buffer);
-    }
-
-    adjustDrift();
-
-    if (_buffers.empty())
-    {
-        printf("AUDIO FULL\n");
-        fflush(stdout);
-        return;
-    }
-
     buffer = _buffers.back();
     _buffers.pop_back();
 
     alBufferData(buffer, AL_FORMAT_MONO_FLOAT32, tmp, len * sizeof(*tmp), 48000);
     alSourceQueueBuffers(_source, 1, &buffer);
-    alGetSourcei(_source, AL_SOURCE_STATE, &attr);
-    if (attr != AL_PLAYING)
-    {
-        printf("AUDIO EMPTY\n");
-        fflush(stdout);
-        alSourcePlay(_source);
-    }
 }
 
 static double lerp(double a, double b, double coeff)
@@ -156,7 +179,29 @@ void Audio::adjustDrift()
     double newDrift;
 
     alGetSourcei(_source, AL_SAMPLE_OFFSET, &currentBufferOffset);
-    queuedSamples = NIN_AUDIO_SAMPLE_SIZE * (kBufferCount - _buffers.size()) - currentBufferOffset;
+    queuedSamples = NIN_AUDIO_SAMPLE_SIZE * (kBufferCount - _buffers.size()) - currentBufferOffset + _ring.size();
     newDrift = (double)queuedSamples / (double)((kBufferCount / 2) * NIN_AUDIO_SAMPLE_SIZE);
     _playbackDrift = lerp(_playbackDrift, newDrift, 1e-5);
 }
+
+/* Overruns lose samples in the emulation thread, underruns are audible gaps */
+void Audio::report()
+{
+    uint64_t overruns;
+    uint64_t underruns;
+
+    overruns = _ring.overruns();
+    underruns = _ring.underruns();
+    if (overruns != _reportedOverruns)
+    {
+        printf("AUDIO OVERRUN (%llu)\n", (unsigned long long)overruns);
+        fflush(stdout);
+        _reportedOverruns = overruns;
+    }
+    if (underruns != _reportedUnderruns)
+    {
+        printf("AUDIO UNDERRUN (%llu)\n", (unsigned long long)underruns);
+        fflush(stdout);
+        _reportedUnderruns = underruns;
+    }
+}
@@ -32,9 +32,11 @@
 #include <cstdint>
 #include <vector>
 #include <QObject>
+#include <QTimer>
 #include <AL/al.h>
 #include <AL/alext.h>
 #include <AL/alc.h>
+#include <NinEmu/Core/AudioRing.h>
 
 class Audio : public QObject
 {
@@ -44,16 +46,23 @@ public:
     explicit Audio(QObject* parent = nullptr);
     virtual ~Audio();
 
-    uint32_t frequency() const;
+    uint32_t    frequency() const;
+    AudioRing&  ring() { return _ring; }
+
+signals:
+    void samples(const float* samples);
 
 public slots:
     void reset();
-    void pushSamples(const float* samples);
+    void feed();
 
 private:
     static const int kBufferCount = 4;
+    static const int kFeedInterval = 4;
 
+    void queueBlock(const float* samples);
     void adjustDrift();
+    void report();
 
     ALCdevice*          _device;
     ALCcontext*         _context;
@@ -61,6 +70,10 @@ private:
     std::vector<ALuint> _buffers;
     uint32_t            _frequency;
     double              _playbackDrift;
+    AudioRing           _ring;
+    QTimer*             _timer;
+    uint64_t            _reportedOverruns;
+    uint64_t            _reportedUnderruns;
 };
 
 #endif
@@ -0,0 +1,95 @@
+/*
+ * BSD 2 - Clause License
+ *
+ * Copyright(c) 2019, Maxime Bacoux
+ * All rights reserved.
+ *
+ * Redistributionand use in sourceand binary forms, with or without
+ * modification, are permitted provided that the following conditions are met :
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditionsand the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditionsand the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <NinEmu/Core/AudioRing.h>
+
+AudioRing::AudioRing()
+: _head(0)
+, _tail(0)
+, _overruns(0)
+, _underruns(0)
+, _samples{}
+{
+
+}
+
+std::size_t AudioRing::size() const
+{
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+}
+
+/* Producer side. Samples that do not fit are dropped and counted. */
+std::size_t AudioRing::write(const float* src, std::size_t count)
+{
+    std::size_t head;
+    std::size_t tail;
+    std::size_t len;
+    std::size_t offset;
+    std::size_t first;
+
+    head = _head.load(std::memory_order_relaxed);
+    tail = _tail.load(std::memory_order_acquire);
+    len = std::min(count, kCapacity - (head - tail));
+    if (len < count)
+        _overruns.fetch_add(1, std::memory_order_relaxed);
+
+    offset = head % kCapacity;
+    first = std::min(len, kCapacity - offset);
+    std::copy(src, src + first, _samples + offset);
+    std::copy(src + first, src + len, _samples);
+    _head.store(head + len, std::memory_order_release);
+    return len;
+}
+
+/* Consumer side */
+std::size_t AudioRing::read(float* dst, std::size_t count)
+{
+    std::size_t head;
+    std::size_t tail;
+    std::size_t len;
+    std::size_t offset;
+    std::size_t first;
+
+    tail = _tail.load(std::memory_order_relaxed);
+    head = _head.load(std::memory_order_acquire);
+    len = std::min(count, head - tail);
+
+    offset = tail % kCapacity;
+    first = std::min(len, kCapacity - offset);
+    std::copy(_samples + offset, _samples + offset + first, dst);
+    std::copy(_samples, _samples + (len - first), dst + first);
+    _tail.store(tail + len, std::memory_order_release);
+    return len;
+}
+
+/* Consumer side, drops everything the producer has written so far */
+void AudioRing::clear()
+{
+    _tail.store(_head.load(std::memory_order_acquire), std::memory_order_release);
+}
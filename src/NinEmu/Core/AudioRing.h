@@ -0,0 +1,65 @@
+/*
+ * BSD 2 - Clause License
+ *
+ * Copyright(c) 2019, Maxime Bacoux
+ * All rights reserved.
+ *
+ * Redistributionand use in sourceand binary forms, with or without
+ * modification, are permitted provided that the following conditions are met :
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditionsand the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditionsand the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AUDIO_RING_H
+#define AUDIO_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Wait-free ring of samples between one producer and one consumer thread.
+ * Neither side ever blocks: the producer counts what did not fit, and the
+ * consumer counts the times it came up short.
+ */
+class AudioRing
+{
+public:
+    static const std::size_t kCapacity = 16384;
+
+    AudioRing();
+
+    std::size_t size() const;
+    std::size_t write(const float* src, std::size_t count);
+    std::size_t read(float* dst, std::size_t count);
+    void        clear();
+
+    uint64_t    overruns() const { return _overruns.load(std::memory_order_relaxed); }
+    uint64_t    underruns() const { return _underruns.load(std::memory_order_relaxed); }
+    void        underrun() { _underruns.fetch_add(1, std::memory_order_relaxed); }
+
+private:
+    std::atomic_size_t              _head;
+    std::atomic_size_t              _tail;
+    std::atomic<uint64_t>           _overruns;
+    std::atomic<uint64_t>           _underruns;
+    float                           _samples[kCapacity];
+};
+
+#endif
@@ -27,6 +27,7 @@
  */
 
 #include <stdio.h>
+#include <cstring>
 #include <QtCore>
 #include <NinEmu/Core/EmulatorWorker.h>
 
@@ -36,9 +37,11 @@ EmulatorWorker::EmulatorWorker(QObject* parent)
 , _workerState(WorkerState::Idle)
 , _input(0)
 , _audioFrequency(48000)
+, _heldFrame(nullptr)
+, _heldSeq(0)
+, _audioRing(nullptr)
 , _state(nullptr)
 {
-    connect(this, &EmulatorWorker::audioEvent, this, &EmulatorWorker::syncAudio, Qt::QueuedConnection);
     _thread = std::thread(&EmulatorWorker::workerMain, this);
 }
 
@@ -63,6 +66,7 @@ bool EmulatorWorker::loadRom(const QString& path)
     NinInt32 frameDelay;
     NinInt32 system;
     NinInt32 diskSideCount;
+    void* frames[3];
     bool success;
 
     std::unique_lock<std::mutex> lock(_mutex);
@@ -90,6 +94,9 @@ bool EmulatorWorker::loadRom(const QString& path)
             ninLoadBiosFDS(_state, raw.data());
         }
 
+        for (int i = 0; i < 3; ++i)
+            frames[i] = _frames[i];
+
         _frameCycles = frameCycles;
         _frameDelay = frameDelay;
         _info.diskSideCount = diskSideCount;
@@ -98,6 +105,7 @@ bool EmulatorWorker::loadRom(const QString& path)
 
         raw = getSaveLocation("nes", path).toUtf8();
         ninSetSaveFile(_state, raw.data());
+        ninSetFrameBuffers(_state, frames, 3);
         ninAudioSetCallback(_state, &audioCallback, this);
         ninAudioSetFrequency(_state, _audioFrequency);
         _workerState = WorkerState::Starting;
@@ -193,10 +201,10 @@ void EmulatorWorker::setAudioFrequency(uint32_t freq)
     _audioFrequency = freq;
 }
 
-void EmulatorWorker::syncAudio()
+/* Must be set before any rom is loaded */
+void EmulatorWorker::setAudioRing(AudioRing* ring)
 {
-    std::unique_lock<std::mutex> lock(_audioMutex);
-    emit audio(_audioBuffer);
+    _audioRing = ring;
 }
 
 void EmulatorWorker::workerMain()
@@ -262,7 +270,7 @@ void EmulatorWorker::workerUpdate()
     ninSetInput(_state, _input);
     if (ninRunCycles(_state, _frameCycles / 4 - cyc, &cyc))
     {
-        emit frame((const char*)ninGetScreenBuffer(_state));
+        workerFrame();
         emit update(_state);
     }
     _cyc = cyc;
@@ -270,17 +278,11 @@ void EmulatorWorker::workerUpdate()
 
 void EmulatorWorker::workerStepFrame()
 {
-    size_t cyc;
-
     ninSetInput(_state, _input);
-    for (;;)
+    if (ninRunFrames(_state, 1, nullptr))
     {
-        if (ninRunCycles(_state, 1, &cyc))
-        {
-            emit frame((const char*)ninGetScreenBuffer(_state));
-            emit update(_state);
-            return;
-        }
+        workerFrame();
+        emit update(_state);
     }
 }
 
@@ -289,15 +291,60 @@ void EmulatorWorker::workerStepSingle()
     ninSetInput(_state, _input);
     if (ninStepInstruction(_state))
     {
-        emit frame((const char*)ninGetScreenBuffer(_state));
+        workerFrame();
     }
     emit update(_state);
 }
 
+void EmulatorWorker::workerFrame()
+{
+    uint8_t dirty[NIN_DIRTY_SIZE];
+    void* texture;
+    void* next;
+
+    /* Keep only the most recent frame, the widget draws straight from it */
+    texture = ninAcquireFrame(_state);
+    if (!texture)
+        return;
+    std::memset(dirty, 0, sizeof(dirty));
+    acquireDirty(texture, dirty);
+    while ((next = ninAcquireFrame(_state)))
+    {
+        ninReleaseFrame(_state, texture);
+        texture = next;
+        acquireDirty(texture, dirty);
+    }
+
+    emit frame((const char*)texture, dirty);
+    if (_heldFrame)
+        ninReleaseFrame(_state, _heldFrame);
+    _heldFrame = texture;
+}
+
+/*
+ * Merges the lines a frame changed since the previous one. When frames were
+ * dropped in between, we can't tell what they changed and redraw everything.
+ */
+void EmulatorWorker::acquireDirty(const void* texture, uint8_t* dirty)
+{
+    uint8_t lines[NIN_DIRTY_SIZE];
+    uint64_t seq;
+
+    seq = ninGetFrameDirty(_state, texture, lines);
+    if (seq != _heldSeq + 1)
+        std::memset(lines, 0xff, sizeof(lines));
+    for (int i = 0; i < NIN_DIRTY_SIZE; ++i)
+        dirty[i] |= lines[i];
+    _heldSeq = seq;
+}
+
 void EmulatorWorker::closeRomRaw()
 {
     if (_state)
     {
+        emit frame(nullptr, nullptr);
+        _heldFrame = nullptr;
+        _heldSeq = 0;
         ninDestroyState(_state);
         _state = nullptr;
     }
@@ -328,9 +375,6 @@ void EmulatorWorker::audioCallback(void* arg, const float* samples)
     EmulatorWorker* emu;
 
     emu = (EmulatorWorker*)arg;
-    {
-        std::unique_lock<std::mutex> lock(emu->_audioMutex);
-        memcpy(emu->_audioBuffer, samples, sizeof(emu->_audioBuffer));
-    }
-    emit emu->audioEvent();
+    if (emu->_audioRing)
+        emu->_audioRing->write(samples, NIN_AUDIO_SAMPLE_SIZE);
 }
@@ -37,6 +37,7 @@
 #include <QObject>
 #include <QString>
 #include <nin/nin.h>
+#include <NinEmu/Core/AudioRing.h>
 #include <NinEmu/Core/EmulatorInfo.h>
 
 class EmulatorWorker : public QObject
@@ -61,13 +62,10 @@ public:
     void inputKeyRelease(uint8_t key);
 
     void setAudioFrequency(uint32_t freq);
-
-    void syncAudio();
+    void setAudioRing(AudioRing* ring);
 
 signals:
-    void frame(const char* texture);
-    void audio(const float* samples);
-    void audioEvent(void);
+    void frame(const char* texture, const uint8_t* dirty);
     void update(NinState* state);
     void reset(const EmulatorInfo& info);
 
@@ -76,6 +74,8 @@ private:
     void workerUpdate();
     void workerStepFrame();
     void workerStepSingle();
+    void workerFrame();
+    void acquireDirty(const void* texture, uint8_t* dirty);
     void closeRomRaw();
 
     QString getSaveLocation(const QString& prefix, const QString& name);
@@ -112,10 +112,13 @@ private:
 
     std::atomic_uint_fast32_t   _audioFrequency;
 
-    std::mutex  _audioMutex;
-    float       _audioBuffer[NIN_AUDIO_SAMPLE_SIZE];
+    /* Written from the emulation thread only, drained by the audio sink */
+    AudioRing*  _audioRing;
 
-    char    _frameBuffer[NIN_FRAME_SIZE];
+    /* The render widget keeps the last frame we emitted, until the next one */
+    uint32_t    _frames[3][NIN_FRAME_SIZE / 4];
+    void*       _heldFrame;
+    uint64_t    _heldSeq;
 
     NinState*   _state;
 };
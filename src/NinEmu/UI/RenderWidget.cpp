@@ -27,19 +27,21 @@
  */
 
 #include <cmath>
+#include <cstring>
 #include <NinEmu/UI/RenderWidget.h>
 
 RenderWidget::RenderWidget(QWidget* parent)
 : QOpenGLWidget{parent}
 , _texture{}
-, _rawTexture{}
+, _frame{}
+, _dirty{}
+, _uploaded{}
 , _fit{}
 , _integerScale{}
 , _pixelAspectRatio{1.0f}
 , _xOverscan{}
 , _yOverscan{}
 {
-    memset(_rawTexture, 0, 256 * 240 * 4);
     computeViewBox();
 }
 
@@ -68,7 +70,12 @@ void RenderWidget::paintGL()
     glBindTexture(GL_TEXTURE_2D, _texture);
 
     _mutex.lock();
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 256, 240, 0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, _rawTexture);
+    if (!_frame)
+    {
+        _mutex.unlock();
+        return;
+    }
+    uploadTexture();
 
     glColor4f(1.f, 1.f, 1.f, 1.f);
     glBegin(GL_QUADS);
@@ -127,14 +134,56 @@ void RenderWidget::setOverscan(int x, int y)
     computeViewBox();
 }
 
-void RenderWidget::updateTexture(const char* texture)
+/*
+ * The texture is owned by the emulator, which will not reuse it until it
+ * hands us the next one. A null texture means there is nothing to draw.
+ * Dirty lines pile up until the next paint, as we may skip some frames.
+ */
+void RenderWidget::updateTexture(const char* texture, const uint8_t* dirty)
 {
     std::unique_lock<std::mutex> lock(_mutex);
 
-    memcpy(_rawTexture, texture, 256 * 240 * 4);
+    _frame = texture;
+    if (!texture)
+        _uploaded = false;
+    else
+    {
+        for (int i = 0; i < NIN_DIRTY_SIZE; ++i)
+            _dirty[i] |= dirty[i];
+    }
     QOpenGLWidget::update();
 }
 
+/* Only sends the runs of lines that changed since the last upload */
+void RenderWidget::uploadTexture()
+{
+    int y;
+    int first;
+
+    if (!_uploaded)
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 256, 240, 0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, _frame);
+        _uploaded = true;
+    }
+    else
+    {
+        y = 0;
+        while (y < 240)
+        {
+            if (!(_dirty[y / 8] & (1 << (y % 8))))
+            {
+                y++;
+                continue;
+            }
+            first = y;
+            while (y < 240 && (_dirty[y / 8] & (1 << (y % 8))))
+                y++;
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, 256, y - first, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, _frame + first * 256 * 4);
+        }
+    }
+    std::memset(_dirty, 0, sizeof(_dirty));
+}
+
 void RenderWidget::computeViewBox()
 {
     int w;
@@ -33,6 +33,7 @@
 #include <cstdint>
 #include <QWidget>
 #include <QOpenGLWidget>
+#include <nin/nin.h>
 
 class RenderWidget : public QOpenGLWidget
 {
@@ -51,14 +52,17 @@ public:
     void setPixelAspectRatio(float pixelAspectRatio);
     void setOverscan(int x, int y);
 
-    void updateTexture(const char* texture);
+    void updateTexture(const char* texture, const uint8_t* dirty);
 
 private:
     void computeViewBox();
+    void uploadTexture();
 
     std::mutex      _mutex;
     GLuint          _texture;
-    char            _rawTexture[256 * 240 * 4];
+    const char*     _frame;
+    uint8_t         _dirty[NIN_DIRTY_SIZE];
+    bool            _uploaded;
     bool            _fit;
     bool            _integerScale;
     float           _pixelAspectRatio;
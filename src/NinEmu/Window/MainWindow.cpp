@@ -55,6 +55,7 @@ MainWindow::MainWindow(QWidget* parent)
     _audio = new Audio(this);
     _emu = new EmulatorWorker(this);
     _emu->setAudioFrequency(48000);
+    _emu->setAudioRing(&_audio->ring());
 
     setWindowTitle("Nin " NIN_VERSION);
 
@@ -74,7 +75,6 @@ MainWindow::MainWindow(QWidget* parent)
 
     connect(_emu, &EmulatorWorker::reset, this, &MainWindow::emulationReset, Qt::DirectConnection);
     connect(_emu, &EmulatorWorker::reset, _audio, &Audio::reset, Qt::DirectConnection);
-    connect(_emu, &EmulatorWorker::audio, _audio, &Audio::pushSamples, Qt::DirectConnection);
     connect(_emu, &EmulatorWorker::frame, _render, &RenderWidget::updateTexture, Qt::DirectConnection);
     connect(_diskMenu, &DiskMenu::insertDisk, _emu, &EmulatorWorker::insertDisk);
 
@@ -216,7 +216,7 @@ void MainWindow::openWindowAudioVisualizer()
     {
         win = new AudioVisualizerWindow;
         win->setAttribute(Qt::WA_DeleteOnClose);
-        connect(_emu, &EmulatorWorker::audio, win, &AudioVisualizerWindow::refresh, Qt::DirectConnection);
+        connect(_audio, &Audio::samples, win, &AudioVisualizerWindow::refresh, Qt::DirectConnection);
         win->show();
         _windowAudioVisualizer = win;
     }
@@ -37,6 +37,35 @@ NIN_API void ninAudioSetFrequency(NinState* state, uint32_t frequency)
     state->audio.setTargetFrequency(frequency);
 }
 
+/* Nudges the output rate by a small ratio, to track the drift of an audio device */
+NIN_API void ninAudioSetRateAdjust(NinState* state, float ratio)
+{
+    state->audio.setRateAdjust(ratio);
+}
+
+/* Muted states skip synthesis, but the APU still behaves the same for the CPU */
+NIN_API void ninSetAudioEnabled(NinState* state, int enabled)
+{
+    state->apu.setAudioEnabled(!!enabled);
+}
+
+/*
+ * Blocks range from NIN_AUDIO_BLOCK_MIN to NIN_AUDIO_SAMPLE_SIZE samples.
+ * They are what the callback receives, and how often samples become
+ * available to ninAudioRead.
+ */
+NIN_API void ninAudioSetBlockSize(NinState* state, size_t size)
+{
+    state->audio.setBlockSize(size);
+}
+
+/* Returns how many samples were read, at most the ones produced so far */
+NIN_API size_t ninAudioRead(NinState* state, void* dst, size_t count, NinAudioFormat format)
+{
+    state->apu.flushAudio();
+    return state->audio.read(dst, count, format);
+}
+
 NIN_API void ninAudioSetCallback(NinState* state, NINAUDIOCALLBACK callback, void* arg)
 {
     state->audio.setCallback(callback, arg);
@@ -97,6 +126,41 @@ NIN_API const uint32_t* ninGetScreenBuffer(NinState* state)
     return state->video.front();
 }
 
+NIN_API void ninSetFrameBuffers(NinState* state, void* const* buffers, size_t count)
+{
+    state->video.setOutputs(buffers, count);
+}
+
+NIN_API void ninSetPixelFormat(NinState* state, NinPixelFormat format)
+{
+    state->video.setFormat(format);
+}
+
+/*
+ * Headless frames still run the PPU exactly, only pixels are skipped.
+ * The switch takes effect at the next frame.
+ */
+NIN_API void ninSetVideoEnabled(NinState* state, int enabled)
+{
+    state->video.setEnabled(!!enabled);
+}
+
+NIN_API void* ninAcquireFrame(NinState* state)
+{
+    return state->video.acquire();
+}
+
+NIN_API void ninReleaseFrame(NinState* state, void* frame)
+{
+    state->video.release(frame);
+}
+
+/* A null frame stands for the one behind ninGetScreenBuffer */
+NIN_API uint64_t ninGetFrameDirty(NinState* state, const void* frame, uint8_t* dirty)
+{
+    return state->video.dirty(frame, dirty);
+}
+
 NIN_API void ninSetInput(NinState* state, uint8_t input)
 {
     state->input.set(input);
@@ -104,13 +168,8 @@ NIN_API void ninSetInput(NinState* state, uint8_t input)
 
 NIN_API int ninRunCycles(NinState* state, size_t cycles, size_t* cyc)
 {
-    for (std::size_t i = 0; i < cycles; ++i)
-    {
-        state->cpu.tick(1);
-        state->ppu.tick(3);
-        state->apu.tick(1);
-        state->mapper.tick();
-    }
+    state->cpu.tick(cycles);
+    state->scheduler.sync();
 
     if (cyc)
     {
@@ -120,12 +179,44 @@ NIN_API int ninRunCycles(NinState* state, size_t cycles, size_t* cyc)
     return state->video.changed();
 }
 
+NIN_API int ninRunFrames(NinState* state, size_t frames, size_t* cyc)
+{
+    std::uint64_t start;
+    int changed;
+
+    start = state->scheduler.cycle();
+    changed = 0;
+    while (frames)
+    {
+        /* The estimate never overshoots, so we stop on the exact cycle */
+        state->cpu.tick(state->ppu.nextFrame());
+        state->scheduler.sync();
+        if (state->video.changed())
+        {
+            changed = 1;
+            frames--;
+        }
+    }
+
+    if (cyc)
+    {
+        *cyc = std::size_t(state->scheduler.cycle() - start);
+    }
+
+    return changed;
+}
+
 NIN_API void ninDumpMemory(NinState* state, uint8_t* dst, uint16_t start, size_t len)
 {
     state->busMain.dump(dst, start, len);
 }
 
 NIN_API NinError ninCreateState(NinState** dst, const char* path)
+{
+    return ninCreateStateEx(dst, path, 0);
+}
+
+NIN_API NinError ninCreateStateEx(NinState** dst, const char* path, uint32_t flags)
 {
     NinState* state;
     NinError err;
@@ -135,6 +226,7 @@ NIN_API NinError ninCreateState(NinState** dst, const char* path)
     if (err == NIN_OK)
     {
         state->audio.setTargetFrequency(48000);
+        state->ppu.setLineCache(!!(flags & NIN_CREATE_LINE_CACHE));
     }
 
     *dst = state;
@@ -169,13 +261,10 @@ NIN_API int ninStepInstruction(NinState* state)
     for (int i = 0; i < 8; ++i)
     {
         state->cpu.tick(1);
-        state->ppu.tick(3);
-        state->apu.tick(1);
-        state->mapper.tick();
-
         if (state->cpu.dispatching())
             break;
     }
+    state->scheduler.sync();
 
     return state->video.changed();
 }
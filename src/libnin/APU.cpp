@@ -31,6 +31,7 @@
 #include <libnin/IRQ.h>
 #include <libnin/Mapper.h>
 #include <libnin/HardwareInfo.h>
+#include <libnin/Scheduler.h>
 
 using namespace libnin;
 
@@ -63,10 +64,15 @@ APU::APU(const HardwareInfo& info, IRQ& irq, Mapper& mapper, Audio& audio)
 , _frameCounter{}
 , _mode{}
 , _irqInhibit{}
+, _audioEnabled{1}
 , _resetClock{}
+, _audioClock{}
+, _audioKey{}
+, _audioLevel{}
 {
     _noise.feedback = 1;
     _dmc.address = 0x8000;
+    resyncAudio();
 }
 
 std::uint8_t APU::regRead(std::uint16_t reg)
@@ -233,9 +239,27 @@ void APU::regWrite(std::uint16_t reg, std::uint8_t value)
     }
 }
 
+/*
+ * With audio off, only what the CPU can observe keeps running: the frame
+ * counter and its IRQ, length counters, and the DMC for its reads. Sweeps
+ * keep running too, so pulses come back at the right pitch. Channel timers,
+ * envelopes and the mixer are left alone.
+ */
+void APU::setAudioEnabled(bool enabled)
+{
+    if (enabled && !_audioEnabled)
+        resyncAudio();
+    _audioEnabled = enabled;
+}
+
+void APU::flushAudio()
+{
+    _audio.flush(_audioClock);
+    _audioClock = 0;
+}
+
 void APU::tick(std::size_t cycles)
 {
-    float sample;
     uint8_t triangleSample;
     uint8_t pulseSample[2];
     uint8_t noiseSample;
@@ -252,12 +276,16 @@ void APU::tick(std::size_t cycles)
                 _frameCounter = 0;
         }
 
-        tickTriangle();
+        if (_audioEnabled)
+            tickTriangle();
         if (!(_frameCounter & 0x1))
         {
-            tickPulse(0);
-            tickPulse(1);
-            tickNoise();
+            if (_audioEnabled)
+            {
+                tickPulse(0);
+                tickPulse(1);
+                tickNoise();
+            }
             tickDMC();
         }
 
@@ -288,16 +316,15 @@ void APU::tick(std::size_t cycles)
         else
             _frameCounter++;
 
-        /* Load the triangle sample */
-        triangleSample = sampleTriangle();
-        pulseSample[0] = samplePulse(0);
-        pulseSample[1] = samplePulse(1);
-        noiseSample = sampleNoise();
-        dmcSample = sampleDMC();
-
-        /* Emit the sample */
-        sample = mix(triangleSample, pulseSample[0], pulseSample[1], noiseSample, dmcSample);
-        _audio.push(sample);
+        if (_audioEnabled)
+        {
+            triangleSample = sampleTriangle();
+            pulseSample[0] = samplePulse(0);
+            pulseSample[1] = samplePulse(1);
+            noiseSample = sampleNoise();
+            dmcSample = sampleDMC();
+            output(triangleSample, pulseSample[0], pulseSample[1], noiseSample, dmcSample);
+        }
     }
 }
 
@@ -351,6 +378,20 @@ void APU::tickNoise()
     }
 }
 
+std::size_t APU::nextEvent() const
+{
+    std::size_t irqCycle;
+
+    if (_mode || _irqInhibit)
+        return kNoEvent;
+    if (_resetClock)
+        return 1;
+    irqCycle = _info.specs().apuFrameIrq;
+    if (_frameCounter >= irqCycle)
+        return 1;
+    return irqCycle - _frameCounter + 1;
+}
+
 void APU::tickDMC()
 {
     std::uint8_t bit;
@@ -401,6 +442,9 @@ void APU::frameHalfPulse(int n)
 {
     ChannelPulse& ch = _pulse[n];
 
+    if (ch.length && !ch.envelope.halt)
+        ch.length--;
+
     if (ch.sweepEnable && ch.sweepValue == 0 && ch.sweepTarget < 0x800)
     {
         ch.timerPeriod = ch.sweepTarget;
@@ -415,9 +459,6 @@ void APU::frameHalfPulse(int n)
     {
         ch.sweepValue--;
     }
-
-    if (ch.length && !ch.envelope.halt)
-        ch.length--;
 }
 
 void APU::frameHalfNoise()
@@ -428,6 +469,10 @@ void APU::frameHalfNoise()
 
 void APU::frameQuarter()
 {
+    /* Envelopes and the linear counter are never visible to the CPU */
+    if (!_audioEnabled)
+        return;
+
     frameQuarterTriangle();
 
     tickEnvelope(_pulse[0].envelope);
@@ -500,6 +545,45 @@ float APU::mix(uint8_t triangle, uint8_t pulse1, uint8_t pulse2, uint8_t noise,
     return fPulse + fTND;
 }
 
+/*
+ * Hands the audio a delta whenever the mixed level moves. Most cycles leave
+ * every channel where it was, so the mixer only runs on actual edges.
+ */
+void APU::output(uint8_t triangle, uint8_t pulse1, uint8_t pulse2, uint8_t noise, uint8_t dmc)
+{
+    std::uint32_t key;
+    int level;
+
+    key = triangle | (pulse1 << 4) | (pulse2 << 8) | (noise << 12) | (std::uint32_t(dmc) << 16);
+    if (key != _audioKey)
+    {
+        _audioKey = key;
+        level = int(mix(triangle, pulse1, pulse2, noise, dmc) * (1 << Audio::kAmplitudeBits) + 0.5f);
+        _audio.delta(_audioClock, level - _audioLevel);
+        _audioLevel = level;
+    }
+    if (++_audioClock == kAudioChunk)
+        flushAudio();
+}
+
+/* Picks up the current level without an edge, or the next one would thump */
+void APU::resyncAudio()
+{
+    std::uint8_t triangle;
+    std::uint8_t pulse1;
+    std::uint8_t pulse2;
+    std::uint8_t noise;
+    std::uint8_t dmc;
+
+    triangle = sampleTriangle();
+    pulse1 = samplePulse(0);
+    pulse2 = samplePulse(1);
+    noise = sampleNoise();
+    dmc = sampleDMC();
+    _audioKey = triangle | (pulse1 << 4) | (pulse2 << 8) | (noise << 12) | (std::uint32_t(dmc) << 16);
+    _audioLevel = int(mix(triangle, pulse1, pulse2, noise, dmc) * (1 << Audio::kAmplitudeBits) + 0.5f);
+}
+
 void APU::loadEnvelope(Envelope& ev, uint8_t value)
 {
     ev.halt = !!(value & 0x20);
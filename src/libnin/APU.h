@@ -48,6 +48,10 @@ public:
     std::uint8_t    regRead(std::uint16_t reg);
     void            regWrite(std::uint16_t reg, std::uint8_t value);
     void            tick(std::size_t cycles);
+    std::size_t     nextEvent() const;
+
+    void            setAudioEnabled(bool enabled);
+    void            flushAudio();
 
 private:
     struct Envelope
@@ -118,6 +122,8 @@ private:
         std::uint8_t    silence:1;
     };
 
+    static constexpr const std::uint32_t kAudioChunk = 4096;
+
     void tickTriangle();
     void tickPulse(int n);
     void tickNoise();
@@ -139,6 +145,8 @@ private:
     std::uint8_t dmcMemoryRead(std::uint16_t addr);
 
     float mix(uint8_t triangle, uint8_t pulse1, uint8_t pulse2, uint8_t noise, uint8_t dmc);
+    void  output(uint8_t triangle, uint8_t pulse1, uint8_t pulse2, uint8_t noise, uint8_t dmc);
+    void  resyncAudio();
 
     void            loadEnvelope(Envelope& ev, std::uint8_t value);
     void            tickEnvelope(Envelope& ev);
@@ -158,7 +166,11 @@ private:
     std::uint16_t       _frameCounter;
     std::uint8_t        _mode:1;
     std::uint8_t        _irqInhibit:1;
+    std::uint8_t        _audioEnabled:1;
     std::uint8_t        _resetClock;
+    std::uint32_t       _audioClock;
+    std::uint32_t       _audioKey;
+    int                 _audioLevel;
 };
 
 };
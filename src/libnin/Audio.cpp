@@ -31,18 +31,33 @@
 #include <libnin/Audio.h>
 #include <libnin/HardwareInfo.h>
 
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
 using namespace libnin;
 
 Audio::Audio(const HardwareInfo& info)
 : _info(info)
 , _callback(nullptr)
 , _callbackArg(nullptr)
-, _targetFrequency(0)
-, _accumulator(0)
-, _samplesRaw{}
-, _samplesCursor{kLowPassFilterWidth / 2}
+, _targetFrequency(kDefaultFrequency)
+, _rateAdjust(1.f)
+, _factor(0)
+, _factorNext(0)
+, _time(0)
+, _sum(0)
+, _kernel{}
+, _buffer{}
+, _samples{}
+, _blockSize(NIN_AUDIO_SAMPLE_SIZE)
+, _ringRead(0)
+, _ringWrite(0)
+, _ring{}
 {
-
+    buildKernel();
+    updateFactor();
+    _factor = _factorNext;
 }
 
 Audio::~Audio()
@@ -58,66 +73,195 @@ void Audio::setCallback(NINAUDIOCALLBACK callback, void* arg)
 
 void Audio::setTargetFrequency(std::uint32_t freq)
 {
+    if (freq < kMinFrequency)
+        freq = kMinFrequency;
+    if (freq > kMaxFrequency)
+        freq = kMaxFrequency;
     _targetFrequency = freq;
+    updateFactor();
+}
+
+void Audio::setBlockSize(std::size_t size)
+{
+    if (size < NIN_AUDIO_BLOCK_MIN)
+        size = NIN_AUDIO_BLOCK_MIN;
+    if (size > NIN_AUDIO_SAMPLE_SIZE)
+        size = NIN_AUDIO_SAMPLE_SIZE;
+    _blockSize = std::uint32_t(size);
 }
 
-void Audio::push(float sample)
+/*
+ * Drains the ring of emitted blocks. Samples nobody reads are overwritten
+ * once the ring is full, oldest first.
+ */
+std::size_t Audio::read(void* dst, std::size_t count, NinAudioFormat format)
 {
-    /* We push samples into a ring buffer */
-    //sample = loPass(sample);
-    _accumulator += kTargetFrequencyRaw;
-    if (_accumulator >= _info.specs().clockRate)
+    std::size_t available;
+    float sample;
+    float* dstFloat;
+    std::int16_t* dstInt;
+
+    available = _ringWrite - _ringRead;
+    if (count > available)
+        count = available;
+
+    dstFloat = (float*)dst;
+    dstInt = (std::int16_t*)dst;
+    for (std::size_t i = 0; i < count; ++i)
     {
-        //sample = hiPass(sample);
-        _accumulator -= _info.specs().clockRate;
-        _samplesRaw[_samplesCursor++] = sample;
-        if (_samplesCursor >= kMaxRawSamples)
+        sample = _ring[(_ringRead + i) & (kRingSize - 1)];
+        if (format == NIN_AUDIO_FORMAT_INT16)
         {
-            resample();
-            std::memmove(_samplesRaw, _samplesRaw + NIN_AUDIO_SAMPLE_SIZE * kOversampling, kLowPassFilterWidth * sizeof(float));
-            _samplesCursor = kLowPassFilterWidth;
-            if (_callback)
-                _callback(_callbackArg, _samples);
+            sample *= 32767.f;
+            if (sample > 32767.f)
+                sample = 32767.f;
+            if (sample < -32768.f)
+                sample = -32768.f;
+            dstInt[i] = std::int16_t(std::lrint(sample));
         }
+        else
+            dstFloat[i] = sample;
     }
+    _ringRead += std::uint32_t(count);
+    return count;
+}
+
+void Audio::setRateAdjust(float ratio)
+{
+    if (ratio < 0.9f)
+        ratio = 0.9f;
+    if (ratio > 1.1f)
+        ratio = 1.1f;
+    _rateAdjust = ratio;
+    updateFactor();
 }
 
-void Audio::resample()
+/*
+ * Records a change in amplitude happening `clock` CPU cycles after the last
+ * flush. Rather than the step itself we add the derivative of a band-limited
+ * step, and integrate when emitting, so each edge costs kTaps additions no
+ * matter how long the level then holds.
+ */
+void Audio::delta(std::uint32_t clock, int delta)
 {
-    static const float kImpulse[kLowPassFilterWidth] = {
-        0.f,                    0.f,                    -0.000527072017573503f, -0.00110984739000885f,
-        -0.00170674802675828f,  -0.00227100929579603f,  -0.00275226865376297f,  -0.00309836514905645f,
-        -0.00325728724657753f,  -0.00317919910449467f,  -0.00281847067702838f,  -0.00213563505184364f,
-        -0.00109919737827612f,  0.000312776387504284f,  0.00211135600758337f,   0.00429578455840068f,
-        0.00685290133382793f,   0.00975698086212377f,   0.0129700040415945f,    0.0164423617746781f,
-        0.0201139756195018f,    0.0239158044840333f,    0.0277716918543809f,    0.0316004950372129f,
-        0.0353184269141432f,    0.0388415321863768f,    0.0420882143723709f,    0.0449817271456541f,
-        0.0474525440849641f,    0.0494405245547295f,    0.0508968001199147f,    0.0517853153879127f,
-        0.0520839691162109f,    0.0517853153879127f,    0.0508968001199147f,    0.0494405245547295f,
-        0.0474525440849641f,    0.0449817271456541f,    0.0420882143723709f,    0.0388415321863768f,
-        0.0353184269141432f,    0.0316004950372129f,    0.0277716918543809f,    0.0239158044840333f,
-        0.0201139756195018f,    0.0164423617746781f,    0.0129700040415945f,    0.00975698086212377f,
-        0.00685290133382793f,   0.00429578455840068f,   0.00211135600758337f,   0.000312776387504284f,
-        -0.00109919737827612f,  -0.00213563505184364f,  -0.00281847067702838f,  -0.00317919910449468f,
-        -0.00325728724657753f,  -0.00309836514905645f,  -0.00275226865376297f,  -0.00227100929579603f,
-        -0.00170674802675828f,  -0.00110984739000886f,  -0.000527072017573502f, -1.17681181491811e-018f
-    };
-
-    float avg = 0;
-    for (unsigned i = 0; i < NIN_AUDIO_SAMPLE_SIZE; ++i)
+    std::uint64_t time;
+    std::int32_t* dst;
+    const std::int16_t* kernel;
+#if defined(__SSE2__)
+    __m128i d;
+    __m128i k;
+    __m128i lo;
+    __m128i hi;
+    __m128i* out;
+#endif
+
+    time = _time + clock * _factor;
+    dst = _buffer + (time >> kTimeBits);
+    kernel = _kernel[(time >> (kTimeBits - kPhaseBits)) & (kPhases - 1)];
+
+#if defined(__SSE2__)
+    /* Deltas and taps both fit in 16 bits, widen the products to 32 */
+    d = _mm_set1_epi16(std::int16_t(delta));
+    out = (__m128i*)dst;
+    for (int i = 0; i < kTaps / 8; ++i)
     {
-        float acc = 0;
+        k = _mm_load_si128((const __m128i*)kernel + i);
+        lo = _mm_mullo_epi16(k, d);
+        hi = _mm_mulhi_epi16(k, d);
+        _mm_storeu_si128(out + 2 * i + 0, _mm_add_epi32(_mm_loadu_si128(out + 2 * i + 0), _mm_unpacklo_epi16(lo, hi)));
+        _mm_storeu_si128(out + 2 * i + 1, _mm_add_epi32(_mm_loadu_si128(out + 2 * i + 1), _mm_unpackhi_epi16(lo, hi)));
+    }
+#else
+    for (int i = 0; i < kTaps; ++i)
+        dst[i] += kernel[i] * delta;
+#endif
+}
 
-        for (unsigned j = 0; j < kLowPassFilterWidth; ++j)
-        {
-            acc += _samplesRaw[i * kOversampling + j] * kImpulse[j];
-        }
-        avg += acc;
-        _samples[i] = acc;
+/*
+ * Moves time forward by `clocks` CPU cycles and emits every block that is
+ * now complete. The samples between two flushes must still fit the buffer,
+ * which the APU ensures by flushing every kAudioChunk cycles.
+ */
+void Audio::flush(std::uint32_t clocks)
+{
+    _time += clocks * _factor;
+    _factor = _factorNext;
+    while ((_time >> kTimeBits) >= _blockSize)
+    {
+        emit();
+        if (_callback)
+            _callback(_callbackArg, _samples);
     }
-    avg /= NIN_AUDIO_SAMPLE_SIZE;
-    for (unsigned i = 0; i < NIN_AUDIO_SAMPLE_SIZE; ++i)
+}
+
+void Audio::emit()
+{
+    static constexpr const float kScale = 1.f / float(1 << (kAmplitudeBits + kKernelBits));
+    std::size_t pending;
+
+    /* Integrate the deltas, leaking a little to act as a high-pass filter */
+    for (unsigned i = 0; i < _blockSize; ++i)
+    {
+        _sum += _buffer[i];
+        _samples[i] = _sum * kScale;
+        _ring[(_ringWrite + i) & (kRingSize - 1)] = _samples[i];
+        _sum -= _sum >> kBassShift;
+    }
+    _ringWrite += _blockSize;
+    if (_ringWrite - _ringRead > kRingSize)
+        _ringRead = _ringWrite - kRingSize;
+
+    /* Keep the samples still being written to */
+    pending = std::size_t(_time >> kTimeBits) - _blockSize + kTaps;
+    std::memmove(_buffer, _buffer + _blockSize, pending * sizeof(*_buffer));
+    std::memset(_buffer + pending, 0, (kMaxSamples - pending) * sizeof(*_buffer));
+    _time -= std::uint64_t(_blockSize) << kTimeBits;
+}
+
+/*
+ * Builds a windowed sinc impulse for each sub-sample phase. Every phase is
+ * nudged to sum to exactly one, so that integration never drifts.
+ */
+void Audio::buildKernel()
+{
+    static constexpr const double kPi = 3.14159265358979323846;
+    static constexpr const double kCutoff = 0.45;
+    double taps[kTaps];
+    double sum;
+    double t;
+    int total;
+    int center;
+
+    for (int p = 0; p < kPhases; ++p)
     {
-        _samples[i] -= avg;
+        sum = 0.0;
+        for (int i = 0; i < kTaps; ++i)
+        {
+            t = (i - (kTaps / 2 - 1)) - double(p) / kPhases;
+            taps[i] = (t == 0.0) ? 1.0 : std::sin(2.0 * kPi * kCutoff * t) / (2.0 * kPi * kCutoff * t);
+            taps[i] *= 0.42 + 0.5 * std::cos(kPi * t / (kTaps / 2)) + 0.08 * std::cos(2.0 * kPi * t / (kTaps / 2));
+            sum += taps[i];
+        }
+
+        total = 0;
+        for (int i = 0; i < kTaps; ++i)
+        {
+            _kernel[p][i] = std::int16_t(std::lround(taps[i] / sum * (1 << kKernelBits)));
+            total += _kernel[p][i];
+        }
+        center = (p < kPhases / 2) ? kTaps / 2 - 1 : kTaps / 2;
+        _kernel[p][center] += std::int16_t((1 << kKernelBits) - total);
     }
 }
+
+/*
+ * The new rate takes effect at the next flush, so that deltas already
+ * recorded and the time they are measured against stay in agreement.
+ */
+void Audio::updateFactor()
+{
+    double rate;
+
+    rate = double(_targetFrequency) * _rateAdjust;
+    _factorNext = std::uint64_t(rate * double(std::uint64_t(1) << kTimeBits) / _info.specs().clockRate);
+}
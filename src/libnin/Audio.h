@@ -29,6 +29,7 @@
 #ifndef LIBNIN_AUDIO_H
 #define LIBNIN_AUDIO_H 1
 
+#include <cstddef>
 #include <cstdint>
 #include <nin/nin.h>
 #include <libnin/NonCopyable.h>
@@ -40,32 +41,56 @@ class HardwareInfo;
 class Audio : private NonCopyable
 {
 public:
+    /* Fixed point scale of the amplitudes handed to delta() */
+    static constexpr const int kAmplitudeBits = 13;
+
     Audio(const HardwareInfo& info);
     ~Audio();
 
     void setCallback(NINAUDIOCALLBACK callback, void* arg);
     void setTargetFrequency(std::uint32_t freq);
+    void setRateAdjust(float ratio);
+    void setBlockSize(std::size_t size);
+
+    std::size_t read(void* dst, std::size_t count, NinAudioFormat format);
 
-    void push(float sample);
+    void delta(std::uint32_t clock, int delta);
+    void flush(std::uint32_t clocks);
 
 private:
-    static constexpr const int kOversampling = 8;
-    static constexpr const int kTargetFrequency = 48000;
-    static constexpr const int kTargetFrequencyRaw = kTargetFrequency * kOversampling;
-    static constexpr const int kLowPassFilterWidth = 64;
-    static constexpr const int kMaxRawSamples = NIN_AUDIO_SAMPLE_SIZE * kOversampling + kLowPassFilterWidth;
+    static constexpr const std::uint32_t kDefaultFrequency = 48000;
+    static constexpr const std::uint32_t kMinFrequency = 8000;
+    static constexpr const std::uint32_t kMaxFrequency = 192000;
+    static constexpr const int kTimeBits = 32;
+    static constexpr const int kPhaseBits = 6;
+    static constexpr const int kPhases = 1 << kPhaseBits;
+    static constexpr const int kTaps = 16;
+    static constexpr const int kKernelBits = 15;
+    static constexpr const int kBassShift = 9;
+    static constexpr const int kMaxSamples = NIN_AUDIO_SAMPLE_SIZE * 2 + kTaps;
+    static constexpr const std::uint32_t kRingSize = 16384;
 
-    void resample();
+    void buildKernel();
+    void updateFactor();
+    void emit();
 
     const HardwareInfo& _info;
 
     NINAUDIOCALLBACK    _callback;
     void*               _callbackArg;
     std::uint32_t       _targetFrequency;
-    std::uint32_t       _accumulator;
-    float               _samplesRaw[kMaxRawSamples];
+    float               _rateAdjust;
+    std::uint64_t       _factor;
+    std::uint64_t       _factorNext;
+    std::uint64_t       _time;
+    std::int32_t        _sum;
+    alignas(16) std::int16_t _kernel[kPhases][kTaps];
+    std::int32_t        _buffer[kMaxSamples];
     float               _samples[NIN_AUDIO_SAMPLE_SIZE];
-    std::uint16_t       _samplesCursor;
+    std::uint32_t       _blockSize;
+    std::uint32_t       _ringRead;
+    std::uint32_t       _ringWrite;
+    float               _ring[kRingSize];
 };
 
 };
@@ -6,22 +6,26 @@
 #include <libnin/Mapper.h>
 #include <libnin/Memory.h>
 #include <libnin/PPU.h>
+#include <libnin/Scheduler.h>
 #include <libnin/Util.h>
 
 using namespace libnin;
 
-BusMain::BusMain(Memory& memory, Cart& cart, Mapper& mapper, PPU& ppu, APU& apu, Input& input)
+BusMain::BusMain(Memory& memory, Cart& cart, Mapper& mapper, PPU& ppu, APU& apu, Input& input, Scheduler& scheduler)
 : _memory{memory}
 , _cart{cart}
 , _mapper{mapper}
 , _ppu{ppu}
 , _apu{apu}
 , _input{input}
+, _scheduler{scheduler}
+, _readPages{mapper.readPages()}
+, _writePages{mapper.writePages()}
 {
 
 }
 
-std::uint8_t BusMain::read(std::uint16_t addr)
+std::uint8_t BusMain::readSlow(std::uint16_t addr)
 {
     switch (addr >> 12)
     {
@@ -30,6 +34,7 @@ std::uint8_t BusMain::read(std::uint16_t addr)
         return _memory.ram[addr & 0x7ff];
     case 0x2:
     case 0x3:
+        _scheduler.sync();
         return _ppu.regRead(addr);
     case 0x4:
         switch (addr)
@@ -55,6 +60,7 @@ std::uint8_t BusMain::read(std::uint16_t addr)
         case 0x4012:
         case 0x4013:
         case 0x4015:
+            _scheduler.sync();
             return _apu.regRead(addr);
         case 0x4016:
             // JOY1
@@ -72,7 +78,7 @@ std::uint8_t BusMain::read(std::uint16_t addr)
         case 0x401f:
             return 0x00;
         default:
-            return _mapper.read(addr);
+            return readMapper(addr);
         }
     case 0x5:
     case 0x6:
@@ -85,13 +91,13 @@ std::uint8_t BusMain::read(std::uint16_t addr)
     case 0xd:
     case 0xe:
     case 0xf:
-        return _mapper.read(addr);
+        return readMapper(addr);
     default:
         UNREACHABLE();
     }
 }
 
-WriteAction BusMain::write(std::uint16_t addr, std::uint8_t value)
+WriteAction BusMain::writeSlow(std::uint16_t addr, std::uint8_t value)
 {
     switch (addr >> 12)
     {
@@ -101,6 +107,7 @@ WriteAction BusMain::write(std::uint16_t addr, std::uint8_t value)
         return WriteAction::None;
     case 0x2:
     case 0x3:
+        _scheduler.sync();
         _mapper.writePassive(addr, value);
         _ppu.regWrite(addr, value);
         return WriteAction::None;
@@ -129,6 +136,7 @@ WriteAction BusMain::write(std::uint16_t addr, std::uint8_t value)
         case 0x4013:
         case 0x4015:
         case 0x4017:
+            _scheduler.sync();
             _apu.regWrite(addr, value);
             return WriteAction::None;
         case 0x4014:
@@ -147,6 +155,7 @@ WriteAction BusMain::write(std::uint16_t addr, std::uint8_t value)
         case 0x401f:
             return WriteAction::None;
         default:
+            _scheduler.sync();
             _mapper.write(addr, value);
             return WriteAction::None;
         }
@@ -161,6 +170,7 @@ WriteAction BusMain::write(std::uint16_t addr, std::uint8_t value)
     case 0xd:
     case 0xe:
     case 0xf:
+        _scheduler.sync();
         _mapper.write(addr, value);
         return WriteAction::None;
     default:
@@ -168,6 +178,14 @@ WriteAction BusMain::write(std::uint16_t addr, std::uint8_t value)
     }
 }
 
+std::uint8_t BusMain::readMapper(std::uint16_t addr)
+{
+    /* Mapper registers may depend on the PPU or on the mapper clock */
+    if (_mapper.hooksRead())
+        _scheduler.sync();
+    return _mapper.read(addr);
+}
+
 static bool memoryExtractOverlap(std::uint16_t start, std::size_t len, std::uint16_t regionStart, std::size_t regionLen, std::size_t* overlapOffset, std::size_t* overlapLen, std::size_t* overlapOffsetInDest)
 {
     std::size_t offset;
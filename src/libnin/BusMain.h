@@ -1,6 +1,7 @@
 #ifndef LIBNIN_BUS_MAIN_H
 #define LIBNIN_BUS_MAIN_H 1
 
+#include <cstdint>
 #include <cstdlib>
 #include <libnin/NonCopyable.h>
 
@@ -19,23 +20,48 @@ class Mapper;
 class PPU;
 class APU;
 class Input;
+class Scheduler;
 class BusMain : private NonCopyable
 {
 public:
-    BusMain(Memory& memory, Cart& cart, Mapper& mapper, PPU& ppu, APU& apu, Input& input);
+    BusMain(Memory& memory, Cart& cart, Mapper& mapper, PPU& ppu, APU& apu, Input& input, Scheduler& scheduler);
 
-    std::uint8_t    read(std::uint16_t addr);
-    WriteAction     write(std::uint16_t addr, std::uint8_t value);
+    std::uint8_t read(std::uint16_t addr)
+    {
+        const std::uint8_t* page = _readPages[addr >> 8];
+        if (page)
+            return page[addr & 0xff];
+        return readSlow(addr);
+    }
+
+    WriteAction write(std::uint16_t addr, std::uint8_t value)
+    {
+        std::uint8_t* page = _writePages[addr >> 8];
+        if (page)
+        {
+            page[addr & 0xff] = value;
+            return WriteAction::None;
+        }
+        return writeSlow(addr, value);
+    }
 
     void dump(std::uint8_t* dst, std::uint16_t start, std::size_t len);
 
 private:
+    std::uint8_t    readSlow(std::uint16_t addr);
+    WriteAction     writeSlow(std::uint16_t addr, std::uint8_t value);
+    std::uint8_t    readMapper(std::uint16_t addr);
+
     Memory&     _memory;
     Cart&       _cart;
     Mapper&     _mapper;
     PPU&        _ppu;
     APU&        _apu;
     Input&      _input;
+    Scheduler&  _scheduler;
+
+    const std::uint8_t* const*  _readPages;
+    std::uint8_t* const*        _writePages;
 };
 
 };
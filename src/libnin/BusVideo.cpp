@@ -44,13 +44,16 @@ BusVideo::BusVideo(Memory& memory, Cart& cart, Mapper& mapper)
 : _memory(memory)
 , _cart(cart)
 , _mapper(mapper)
+, _readPages{mapper.videoReadPages()}
+, _writePages{mapper.videoWritePages()}
+, _ntGenerations{mapper.ntGenerations()}
+, _chrGenerations{mapper.chrGenerations()}
 {
 
 }
 
-std::uint8_t BusVideo::read(std::uint16_t addr)
+std::uint8_t BusVideo::readSlow(std::uint16_t addr)
 {
-    addr &= 0x3fff;
     _mapper.videoRead(addr);
     if (addr < 0x2000)
         return _mapper.chrRead(addr / 0x400, addr & 0x3ff);
@@ -74,9 +77,13 @@ std::uint8_t BusVideo::read(std::uint16_t addr)
         return _memory.palettes[addr & 0x1f];
 }
 
-void BusVideo::write(std::uint16_t addr, std::uint8_t value)
+void BusVideo::writeSlow(std::uint16_t addr, std::uint8_t value)
 {
-    addr &= 0x3fff;
+    if (addr < 0x2000)
+        (*_chrGenerations[addr / 0x400])++;
+    else if (addr < 0x3f00)
+        touchNametable(_ntGenerations[(addr >> 10) & 3], addr & 0x3ff);
+
     if (addr < 0x2000)
         _mapper.chrWrite(addr / 0x400, addr & 0x3ff, value);
     else if (addr < 0x2400)
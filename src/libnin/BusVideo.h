@@ -43,13 +43,52 @@ class BusVideo : private NonCopyable
 public:
     BusVideo(Memory& memory, Cart& cart, Mapper& mapper);
 
-    std::uint8_t    read(std::uint16_t addr);
-    void            write(std::uint16_t addr, std::uint8_t value);
+    std::uint8_t read(std::uint16_t addr)
+    {
+        const std::uint8_t* page;
+
+        addr &= 0x3fff;
+        page = _readPages[addr >> 10];
+        if (page)
+            return page[addr & 0x3ff];
+        return readSlow(addr);
+    }
+
+    void write(std::uint16_t addr, std::uint8_t value)
+    {
+        std::uint8_t* page;
+
+        addr &= 0x3fff;
+        page = _writePages[addr >> 10];
+        if (page)
+        {
+            /* Only nametables are ever written directly */
+            page[addr & 0x3ff] = value;
+            touchNametable(_ntGenerations[(addr >> 10) & 3], addr & 0x3ff);
+            return;
+        }
+        writeSlow(addr, value);
+    }
 
 private:
+    static void touchNametable(std::uint32_t* generations, std::uint16_t offset)
+    {
+        generations[offset >> 5]++;
+        if (offset >= 0x3c0)
+            generations[32 + ((offset - 0x3c0) >> 3)]++;
+    }
+
+    std::uint8_t    readSlow(std::uint16_t addr);
+    void            writeSlow(std::uint16_t addr, std::uint8_t value);
+
     Memory& _memory;
     Cart&   _cart;
     Mapper& _mapper;
+
+    const std::uint8_t* const*  _readPages;
+    std::uint8_t* const*        _writePages;
+    std::uint32_t* const*       _ntGenerations;
+    std::uint32_t* const*       _chrGenerations;
 };
 
 }
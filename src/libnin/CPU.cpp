@@ -26,23 +26,99 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
+#include <cstring>
 #include <libnin/APU.h>
 #include <libnin/BusMain.h>
+#include <libnin/Cart.h>
 #include <libnin/CPU.h>
 #include <libnin/IRQ.h>
+#include <libnin/Mapper.h>
+#include <libnin/Memory.h>
 #include <libnin/NMI.h>
 #include <libnin/PPU.h>
+#include <libnin/Scheduler.h>
 
 using namespace libnin;
 
-CPU::CPU(Memory& memory, IRQ& irq, NMI& nmi, PPU& ppu, APU& apu, BusMain& bus)
+/*
+ * Recognizes the loops games use to wait for an interrupt or for vblank:
+ * a JMP to itself, or a load from RAM or PPUSTATUS followed by a branch
+ * back to the load. Returns the cycles of one iteration, or 0.
+ */
+static std::uint8_t idleLoop(std::uint16_t addr, const std::uint8_t* code, std::size_t avail)
+{
+    std::uint16_t src;
+    std::uint16_t next;
+    std::uint16_t target;
+    std::uint8_t len;
+    std::uint8_t cycles;
+
+    if (avail >= 3 && code[0] == 0x4c && code[1] == (addr & 0xff) && code[2] == (addr >> 8))
+        return 3;
+
+    switch (code[0])
+    {
+    case 0x24: // BIT zp
+    case 0xa4: // LDY zp
+    case 0xa5: // LDA zp
+    case 0xa6: // LDX zp
+        len = 2;
+        cycles = 3;
+        src = code[1];
+        break;
+    case 0x2c: // BIT abs
+    case 0xac: // LDY abs
+    case 0xad: // LDA abs
+    case 0xae: // LDX abs
+        if (avail < 3)
+            return 0;
+        len = 3;
+        cycles = 4;
+        src = code[1] | ((std::uint16_t)code[2] << 8);
+        break;
+    default:
+        return 0;
+    }
+
+    /* Anything else than RAM or PPUSTATUS could have side effects */
+    if (src >= 0x2000 && (src >= 0x4000 || (src & 0x07) != 0x02))
+        return 0;
+
+    if (avail < std::size_t(len + 2) || (code[len] & 0x1f) != 0x10)
+        return 0;
+    next = addr + len + 2;
+    target = next + (std::int8_t)code[len + 1];
+    if (target != addr)
+        return 0;
+
+    /* A taken branch costs one more cycle when crossing a page */
+    cycles += 3;
+    if ((next & 0xff00) != (target & 0xff00))
+        cycles++;
+    return cycles;
+}
+
+CPU::CPU(Memory& memory, IRQ& irq, NMI& nmi, PPU& ppu, APU& apu, Cart& cart, Mapper& mapper, BusMain& bus, Scheduler& scheduler)
 : _memory{memory}
 , _irq {irq}
 , _nmi{nmi}
 , _ppu{ppu}
 , _apu{apu}
+, _cart{cart}
+, _mapper{mapper}
 , _bus{bus}
+, _scheduler{scheduler}
+, _decoded{}
+, _decodedBase{}
+, _decodedCount{}
+, _decodedKeys{}
+, _decodedSlots{}
+, _operands{}
 , _handler{kOps[0x100]}
+#if defined(NIN_CPU_STEPS)
+, _step{kOpSteps[0x100]}
+#endif
 , _pc{}
 , _addr{}
 , _regs{}
@@ -52,29 +128,63 @@ CPU::CPU(Memory& memory, IRQ& irq, NMI& nmi, PPU& ppu, APU& apu, BusMain& bus)
 , _irqPending{}
 , _odd{}
 , _reset{true}
+, _fused{kAotBlockCount != 0}
 {
 
 }
 
+CPU::~CPU()
+{
+    for (std::uint16_t i = 0; i < _decodedCount; ++i)
+        delete[] _decoded[i];
+    delete[] _decoded;
+}
+
 std::size_t CPU::tick(std::size_t cycles)
 {
+#if defined(NIN_CPU_STEPS)
+    _cyclesLeft = cycles;
+    runSteps();
+    return 0;
+#else
     Handler handler;
 
     handler = _handler;
-    for (std::size_t i = 0; i < cycles; ++i)
+    _cyclesLeft = cycles;
+    while (_cyclesLeft)
     {
+        if (_scheduler.due())
+            _scheduler.schedule();
         handler = (this->*handler)();
         _odd = !_odd;
+        _scheduler.advance();
+        _cyclesLeft--;
     }
     _handler = handler;
     return 0;
+#endif
 }
 
 CPU::Handler CPU::dispatch()
 {
+    const Decoded* decoded;
     Handler handler;
     std::uint16_t op;
 
+    decoded = nextOp(op);
+    if (decoded)
+        handler = decoded->handler;
+    else
+        handler = _fused ? kFusedOps[op] : kOps[op];
+    return (this->*handler)();
+}
+
+/*
+ * Handles pending interrupts and fetches the next opcode. Returns the decoded
+ * instruction when it comes from the cache, otherwise sets op.
+ */
+const CPU::Decoded* CPU::nextOp(std::uint16_t& op)
+{
     if (_nmiPending)
     {
         _nmiPending = false;
@@ -90,12 +200,69 @@ CPU::Handler CPU::dispatch()
     }
     else
     {
+        const Decoded* decoded = decode(_pc);
+        if (decoded)
+        {
+            if (decoded->idle)
+                skipIdle(decoded->idle);
+            _pc++;
+            _operands = decoded->operands;
+            return decoded;
+        }
         op = read(_pc++);
     }
-    handler = kOps[op];
-    return (this->*handler)();
+    _operands = nullptr;
+    return nullptr;
+}
+
+#if defined(NIN_CPU_STEPS)
+/*
+ * Returns the first step of the next instruction, to be run on this cycle.
+ * The fused core has no steps and runs the instruction right away.
+ */
+CPU::Step CPU::dispatchStep()
+{
+    const Decoded* decoded;
+    Handler handler;
+    std::uint16_t op;
+
+    decoded = nextOp(op);
+    if (!_fused)
+        return decoded ? decoded->step : kOpSteps[op];
+    handler = decoded ? decoded->handler : kFusedOps[op];
+    return stepOf((this->*handler)());
+}
+
+/*
+ * Anything that is not a plain instruction step (fused instructions, DMA)
+ * keeps running through its handler until it gets back to dispatch.
+ */
+CPU::Step CPU::stepOf(Handler handler)
+{
+    if (handler == Handler(&CPU::dispatch))
+        return kStepDispatch;
+    _handler = handler;
+    return kStepHandler;
 }
 
+CPU::Step CPU::writeStep(std::uint16_t addr, std::uint8_t value, Step next)
+{
+    Handler handler;
+
+    handler = write(addr, value, &CPU::dispatch);
+    if (handler == Handler(&CPU::dispatch))
+        return next;
+
+    /* DMA resumes the instruction through its handler */
+    if (next == kStepDispatch)
+        _handler2 = &CPU::dispatch;
+    else
+        _handler2 = kStates[next - kStepInstruction];
+    _handler = handler;
+    return kStepHandler;
+}
+#endif
+
 CPU::Handler CPU::kil()
 {
     return &CPU::kil;
@@ -116,6 +283,7 @@ CPU::Handler CPU::dmaRead()
 
 CPU::Handler CPU::dmaWrite()
 {
+    _scheduler.sync();
     _ppu.oamWrite(_dmaValue);
     _dmaCount++;
     return _dmaCount ? Handler(&CPU::dmaRead) : _handler2;
@@ -126,6 +294,214 @@ std::uint8_t CPU::read(std::uint16_t addr)
     return _bus.read(addr);
 }
 
+std::uint8_t CPU::fetch()
+{
+    if (_operands)
+    {
+        _pc++;
+        return *_operands++;
+    }
+    return read(_pc++);
+}
+
+const CPU::Decoded* CPU::decode(std::uint16_t addr)
+{
+    Decoded* decoded;
+    std::uint16_t offset;
+    int slot;
+
+    if (addr < 0x8000)
+        return nullptr;
+    slot = (addr >> 13) - 4;
+    offset = addr & 0x1fff;
+
+    /* Operands must come from the same bank */
+    if (offset >= 0x1ffe)
+        return nullptr;
+
+    if (_decodedKeys[slot] != _mapper.bank(slot + 2))
+    {
+        _decodedKeys[slot] = _mapper.bank(slot + 2);
+        _decodedSlots[slot] = decodeSlot(slot + 2);
+    }
+    decoded = _decodedSlots[slot];
+    if (!decoded)
+        return nullptr;
+    decoded += offset;
+    if (!decoded->handler.p)
+    {
+        const std::uint8_t* src = _decodedKeys[slot] + offset;
+        decoded->handler = _fused ? aotLookup(addr, src) : kOps[src[0]];
+        decoded->operands[0] = src[1];
+        decoded->operands[1] = src[2];
+        decoded->idle = idleLoop(addr, src, 0x2000 - offset);
+#if defined(NIN_CPU_STEPS)
+        decoded->step = kOpSteps[src[0]];
+#endif
+    }
+    return decoded;
+}
+
+/*
+ * Fast-forwards through whole iterations of an idle loop, up to the next
+ * scheduled event. Only done when running one more iteration would leave
+ * the CPU, RAM and PPU exactly as they are, so the skipped iterations
+ * cannot be observed.
+ */
+void CPU::skipIdle(std::uint8_t cycles)
+{
+    const std::uint8_t* code;
+    std::uint16_t addr;
+    std::uint8_t value;
+    std::uint8_t branch;
+    std::uint8_t p;
+    std::uint8_t flag;
+    std::size_t avail;
+    std::size_t skip;
+
+    /* A register write may have raised a line the loop has not polled yet */
+    if (_nmi.high() || (_irq.high() && !(_p & PFLAG_I)))
+        return;
+
+    code = _mapper.bank((_pc >> 13) - 2) + (_pc & 0x1fff);
+    avail = kNoEvent;
+    if (code[0] != 0x4c)
+    {
+        addr = code[1];
+        if (code[0] & 0x08)
+            addr |= ((std::uint16_t)code[2] << 8);
+        if (addr < 0x2000)
+            value = _memory.ram[addr & 0x7ff];
+        else
+        {
+            _scheduler.schedule();
+            if (!_ppu.statusStable(&value))
+                return;
+            avail = _ppu.statusEvent();
+        }
+
+        p = _p;
+        switch (code[0] & 0xe3)
+        {
+        case 0x20: // BIT
+            p &= ~(PFLAG_N | PFLAG_V | PFLAG_Z);
+            p |= (value & 0xc0);
+            p |= ((_a & value) ? 0 : PFLAG_Z);
+            break;
+        case 0xa0: // LDY
+            if (_y != value)
+                return;
+            break;
+        case 0xa1: // LDA
+            if (_a != value)
+                return;
+            break;
+        case 0xa2: // LDX
+            if (_x != value)
+                return;
+            break;
+        }
+        if (code[0] != 0x24 && code[0] != 0x2c)
+        {
+            p &= ~(PFLAG_N | PFLAG_Z);
+            p |= (value & 0x80);
+            p |= (value ? 0 : PFLAG_Z);
+        }
+        if (p != _p)
+            return;
+
+        /* The loop only repeats if the branch is taken */
+        branch = code[(code[0] & 0x08) ? 3 : 2];
+        switch (branch >> 6)
+        {
+        case 0: flag = PFLAG_N; break;
+        case 1: flag = PFLAG_V; break;
+        case 2: flag = PFLAG_C; break;
+        default: flag = PFLAG_Z; break;
+        }
+        if (!!(p & flag) != !!(branch & 0x20))
+            return;
+    }
+
+    if (_scheduler.deadline() <= _scheduler.cycle())
+        return;
+    avail = std::min<std::size_t>(avail, std::size_t(_scheduler.deadline() - _scheduler.cycle()) - 1);
+    avail = std::min<std::size_t>(avail, _cyclesLeft - 1);
+    skip = avail - avail % cycles;
+    if (!skip)
+        return;
+
+    _scheduler.skip(skip);
+    _cyclesLeft -= skip;
+    if (skip & 1)
+        _odd = !_odd;
+}
+
+CPU::Handler CPU::aotLookup(std::uint16_t addr, const std::uint8_t* src)
+{
+    const AotBlock* block;
+    std::size_t lo;
+    std::size_t hi;
+    std::size_t mid;
+
+    lo = 0;
+    hi = kAotBlockCount;
+    while (lo < hi)
+    {
+        mid = (lo + hi) / 2;
+        if (kAotBlocks[mid].addr < addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    /* A compiled block is only valid if the bank holds the same code */
+    if (lo < kAotBlockCount)
+    {
+        block = kAotBlocks + lo;
+        if (block->addr == addr && (addr & 0x1fff) + block->size <= 0x2000 && std::memcmp(src, block->bytes, block->size) == 0)
+            return block->run;
+    }
+    return kFusedOps[src[0]];
+}
+
+CPU::Decoded* CPU::decodeSlot(int slot)
+{
+    const CartSegment& seg = _cart.segment(CART_PRG_ROM);
+    const std::uint8_t* bank;
+    std::size_t index;
+
+    /* Only plain PRG ROM is cached, RAM and mapper reads go through the bus */
+    bank = _mapper.bank(slot);
+    if (!bank || _mapper.bankWritable(slot) || _mapper.hooksRead())
+        return nullptr;
+    if (bank < seg.base || bank >= seg.base + std::size_t(seg.bankCount) * 0x2000)
+        return nullptr;
+
+    /* The ROM was reloaded, drop everything */
+    if (_decodedBase != seg.base)
+    {
+        for (std::uint16_t i = 0; i < _decodedCount; ++i)
+            delete[] _decoded[i];
+        delete[] _decoded;
+        _decodedBase = seg.base;
+        _decodedCount = seg.bankCount;
+        _decoded = new Decoded*[_decodedCount]();
+        for (int i = 0; i < 4; ++i)
+        {
+            if (i == slot - 2)
+                continue;
+            _decodedKeys[i] = nullptr;
+            _decodedSlots[i] = nullptr;
+        }
+    }
+
+    index = std::size_t(bank - seg.base) / 0x2000;
+    if (!_decoded[index])
+        _decoded[index] = new Decoded[0x2000]();
+    return _decoded[index];
+}
+
 CPU::Handler CPU::write(std::uint16_t addr, std::uint8_t value, Handler next)
 {
     switch (_bus.write(addr, value))
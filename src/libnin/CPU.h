@@ -54,17 +54,25 @@ namespace libnin
 {
 
 class Memory;
+class Cart;
+class Mapper;
 class IRQ;
 class NMI;
 class PPU;
 class APU;
 class BusMain;
+class Scheduler;
 class CPU : private NonCopyable
 {
 public:
-    CPU(Memory& memory, IRQ& irq, NMI& nmi, PPU& ppu, APU& apu, BusMain& bus);
+    CPU(Memory& memory, IRQ& irq, NMI& nmi, PPU& ppu, APU& apu, Cart& cart, Mapper& mapper, BusMain& bus, Scheduler& scheduler);
+    ~CPU();
 
+#if defined(NIN_CPU_STEPS)
+    bool            dispatching() const { return _step == kStepDispatch; }
+#else
     bool            dispatching() const { return _handler == &CPU::dispatch; }
+#endif
 
     std::uint8_t    reg(int r) const { return _regs[r]; }
     std::uint16_t   pc() const { return _pc; }
@@ -73,19 +81,66 @@ public:
 
 private:
     using Handler = MemberStateHelper<CPU>;
+    using Step = std::uint16_t;
+
+    /*
+     * Integer step IDs, used instead of handlers when the CPU is built with
+     * NIN_CPU_DISPATCH set to switch or goto. Instruction steps follow the
+     * order of kStates.
+     */
+    static constexpr const Step kStepDispatch = 0;
+    static constexpr const Step kStepKil = 1;
+    static constexpr const Step kStepHandler = 2;
+    static constexpr const Step kStepInstruction = 3;
+
+    struct Decoded
+    {
+        Handler         handler;
+        std::uint8_t    operands[2];
+        std::uint8_t    idle;
+#if defined(NIN_CPU_STEPS)
+        Step            step;
+#endif
+    };
+
+    struct AotBlock
+    {
+        std::uint16_t       addr;
+        std::uint16_t       size;
+        const std::uint8_t* bytes;
+        Handler::Pointer    run;
+    };
 
     template <int> Handler instruction(void);
+    template <int> Handler fused(void);
+    template <int> Handler aot(void);
+
+    bool fusedStep();
+    bool aotStep(Handler next, const std::uint8_t* operands);
+    Handler aotLookup(std::uint16_t addr, const std::uint8_t* src);
 
     Handler dispatch();
+    const Decoded* nextOp(std::uint16_t& op);
     Handler kil();
     Handler dma();
     Handler dmaRead();
     Handler dmaWrite();
 
     std::uint8_t    read(std::uint16_t addr);
+    std::uint8_t    fetch();
+    const Decoded*  decode(std::uint16_t addr);
+    Decoded*        decodeSlot(int slot);
+    void            skipIdle(std::uint8_t cycles);
     Handler         write(std::uint16_t addr, std::uint8_t value, Handler next);
     std::uint8_t    adc(std::uint8_t a, std::uint8_t b);
 
+#if defined(NIN_CPU_STEPS)
+    void    runSteps();
+    Step    dispatchStep();
+    Step    stepOf(Handler handler);
+    Step    writeStep(std::uint16_t addr, std::uint8_t value, Step next);
+#endif
+
     void flagNZ(std::uint8_t value)
     {
         _p &= ~(PFLAG_N | PFLAG_Z);
@@ -95,15 +150,35 @@ private:
 
     static const Handler kOps[];
     static const Handler kStates[];
+    static const Handler kFusedOps[];
+#if defined(NIN_CPU_STEPS)
+    static const Step kOpSteps[];
+#endif
+    static const AotBlock kAotBlocks[];
+    static const std::size_t kAotBlockCount;
 
     Memory&     _memory;
     IRQ&        _irq;
     NMI&        _nmi;
     PPU&        _ppu;
     APU&        _apu;
+    Cart&       _cart;
+    Mapper&     _mapper;
     BusMain&    _bus;
+    Scheduler&  _scheduler;
+
+    Decoded**           _decoded;
+    const std::uint8_t* _decodedBase;
+    std::uint16_t       _decodedCount;
+    const std::uint8_t* _decodedKeys[4];
+    Decoded*            _decodedSlots[4];
+    const std::uint8_t* _operands;
 
     Handler         _handler;
+#if defined(NIN_CPU_STEPS)
+    Step            _step;
+#endif
+    std::size_t     _cyclesLeft;
     Handler         _handler2;
     std::size_t     _cyc;
     std::uint16_t   _pc;
@@ -132,6 +207,7 @@ private:
     bool            _irqPending:1;
     bool            _odd:1;
     bool            _reset:1;
+    bool            _fused:1;    /* Runs fused instructions, set when AOT blocks are linked in */
 };
 
 }
@@ -0,0 +1,11 @@
+#include <libnin/CPU.h>
+
+/* Default when no module generated by ninaot is linked in */
+#if !defined(NIN_AOT_MODULE)
+
+using namespace libnin;
+
+const CPU::AotBlock CPU::kAotBlocks[] = { { 0, 0, nullptr, nullptr } };
+const std::size_t CPU::kAotBlockCount = 0;
+
+#endif
@@ -32,6 +32,14 @@
 #include <libnin/CPU.h>
 #include <libnin/IRQ.h>
 #include <libnin/NMI.h>
+#include <libnin/Scheduler.h>
+
+/*
+ * Steps refer to the next state and to bus writes through these, so the
+ * generator can redefine them when emitting integer step IDs.
+ */
+#define StateDispatch       &CPU::dispatch
+#define StateWrite(a, v)    write(a, v, next)
 
 #define PollInterrupts      _nmiPending = _nmi.high(); _irqPending = (_irq.high() && !(_p & PFLAG_I));
 #define PollInterrupts2     _nmiPending = (_nmiPending || _nmi.high()); _irqPending = (_irqPending || (_irq.high() && !(_p & PFLAG_I)));
@@ -53,20 +61,20 @@
 #define IncPC           _pc++;
 
 #define AddrImpl            read(_pc);
-#define AddrImplIncPC       read(_pc++);
-#define AddrZero            _addr = read(_pc++);
+#define AddrImplIncPC       fetch();
+#define AddrZero            _addr = fetch();
 #define AddrZeroX           _addr = (_addr + _x) & 0xff;
 #define AddrZeroY           _addr = (_addr + _y) & 0xff;
-#define AddrAbsLo           _addr = ((_addr & 0xff00) | read(_pc++));
-#define AddrAbsHi           _addr = ((_addr & 0x00ff) | ((std::uint16_t)read(_pc++)) << 8);
-#define AddrAbsHiX          _addrCarry = (((_addr & 0xff) + _x) > 0xff) ? 1 : 0; _addr = (((_addr + _x) & 0x00ff) | ((std::uint16_t)read(_pc++)) << 8);
-#define AddrAbsHiY          _addrCarry = (((_addr & 0xff) + _y) > 0xff) ? 1 : 0; _addr = (((_addr + _y) & 0x00ff) | ((std::uint16_t)read(_pc++)) << 8);
+#define AddrAbsLo           _addr = ((_addr & 0xff00) | fetch());
+#define AddrAbsHi           _addr = ((_addr & 0x00ff) | ((std::uint16_t)fetch()) << 8);
+#define AddrAbsHiX          _addrCarry = (((_addr & 0xff) + _x) > 0xff) ? 1 : 0; _addr = (((_addr + _x) & 0x00ff) | ((std::uint16_t)fetch()) << 8);
+#define AddrAbsHiY          _addrCarry = (((_addr & 0xff) + _y) > 0xff) ? 1 : 0; _addr = (((_addr + _y) & 0x00ff) | ((std::uint16_t)fetch()) << 8);
 #define AddrCarry           read(_addr); _addr += (((std::uint16_t)_addrCarry) << 8);
 #define AddrCarry_SHX       read(_addr); if (_addrCarry) _addr = (((_addr & 0x00ff) | ((_addr >> 8) + 1)) & _x);
 #define AddrCarry_SHY       read(_addr); if (_addrCarry) _addr = (((_addr & 0x00ff) | ((_addr >> 8) + 1)) & _y);
 #define AddrCarry_AHX       read(_addr); if (_addrCarry) _addr = (((_addr & 0x00ff) | ((_addr >> 8) + 1)) & _a & _x);
 #define AddrCarryIf         if (!_addrCarry) {
-#define AddrCarryEnd        return &CPU::dispatch; }
+#define AddrCarryEnd        return StateDispatch; }
 #define AddrCarryFix        _addr += 0x100;
 #define AddrIndirectLo      _addr = _addr | ((std::uint16_t)_memory.ram[_addr] << 8);
 #define AddrIndirectHi      _addr = (_addr >> 8) | ((std::uint16_t)_memory.ram[(_addr + 1) & 0xff] << 8);
@@ -75,7 +83,7 @@
 #define DummyLoad           read(_addr);
 
 #define TmpLoad             std::uint8_t tmp = read(_addr);
-#define TmpLoadImm          std::uint8_t tmp = read(_pc++);
+#define TmpLoadImm          std::uint8_t tmp = fetch();
 #define TmpLoadZero         std::uint8_t tmp = _memory.ram[_addr];
 #define TmpLoadAcc          std::uint8_t tmp = _a;
 #define TmpLoadRmw          std::uint8_t tmp = _rmw;
@@ -84,20 +92,20 @@
 
 #define RmwLoad             _rmw = read(_addr);
 #define RmwLoadZero         _rmw = _memory.ram[_addr];
-#define RmwStore            next = write(_addr, _rmw, next);
+#define RmwStore            next = StateWrite(_addr, _rmw);
 #define RmwStoreZero        _memory.ram[_addr] = _rmw;
 
-#define BranchClearC    if (_p & PFLAG_C) { return &CPU::dispatch; }
-#define BranchClearN    if (_p & PFLAG_N) { return &CPU::dispatch; }
-#define BranchClearV    if (_p & PFLAG_V) { return &CPU::dispatch; }
-#define BranchClearZ    if (_p & PFLAG_Z) { return &CPU::dispatch; }
-#define BranchSetC      if (!(_p & PFLAG_C)) { return &CPU::dispatch; }
-#define BranchSetN      if (!(_p & PFLAG_N)) { return &CPU::dispatch; }
-#define BranchSetV      if (!(_p & PFLAG_V)) { return &CPU::dispatch; }
-#define BranchSetZ      if (!(_p & PFLAG_Z)) { return &CPU::dispatch; }
+#define BranchClearC    if (_p & PFLAG_C) { return StateDispatch; }
+#define BranchClearN    if (_p & PFLAG_N) { return StateDispatch; }
+#define BranchClearV    if (_p & PFLAG_V) { return StateDispatch; }
+#define BranchClearZ    if (_p & PFLAG_Z) { return StateDispatch; }
+#define BranchSetC      if (!(_p & PFLAG_C)) { return StateDispatch; }
+#define BranchSetN      if (!(_p & PFLAG_N)) { return StateDispatch; }
+#define BranchSetV      if (!(_p & PFLAG_V)) { return StateDispatch; }
+#define BranchSetZ      if (!(_p & PFLAG_Z)) { return StateDispatch; }
 
 #define BranchTake      _addrCarry = (((_pc + (std::int8_t)_addr) ^ _pc) & 0xff00) ? 1 : 0; _addr = _pc + (std::int8_t)_addr; _pc = ((_pc & 0xff00) | (_addr & 0xff));
-#define BranchTake2     if (!_addrCarry) return &CPU::dispatch; _pc = _addr;
+#define BranchTake2     if (!_addrCarry) return StateDispatch; _pc = _addr;
 
 #define PushPCL         _memory.ram[0x100 | _s] = (_pc & 0xff);
 #define PushPCH         _memory.ram[0x100 | _s] = (_pc >> 8);
@@ -113,9 +121,9 @@
 #define VectorPCH           _pc = ((_pc & 0x00ff) | (((std::uint16_t)read(_addr + 1)) << 8));
 #define VectorPCH_NoCarry   _pc = ((_pc & 0x00ff) | ((std::uint16_t)read((_addr & 0xff00) | ((_addr + 1) & 0xff))) << 8);
 
-#define ImmLoadA        _a = read(_pc++); flagNZ(_a);
-#define ImmLoadX        _x = read(_pc++); flagNZ(_x);
-#define ImmLoadY        _y = read(_pc++); flagNZ(_y);
+#define ImmLoadA        _a = fetch(); flagNZ(_a);
+#define ImmLoadX        _x = fetch(); flagNZ(_x);
+#define ImmLoadY        _y = fetch(); flagNZ(_y);
 
 #define OpORA        _regs[_selDst] |= tmp; flagNZ(_regs[_selDst]);
 #define OpAND        _regs[_selDst] &= tmp; flagNZ(_regs[_selDst]);
@@ -161,26 +169,26 @@
 #define FlagSetI        _p |= PFLAG_I;
 #define FlagSetD        _p |= PFLAG_D;
 
-#define WriteReg        next = write(_addr, _regs[_selSrc], next);
+#define WriteReg        next = StateWrite(_addr, _regs[_selSrc]);
 #define WriteRegZero    _memory.ram[_addr] = _regs[_selSrc];
 
-#define WriteReg_SAX        next = write(_addr, _a & _x, next);
-#define WriteReg_SHX        next = write(_addr, _x & ((_addr >> 8) + 1), next);
-#define WriteReg_SHY        next = write(_addr, _y & ((_addr >> 8) + 1), next);
-#define WriteReg_AHX        next = write(_addr, _a & _x & ((_addr >> 8) + 1), next);
-#define WriteReg_TAS        _s = _a & _x; next = write(_addr, _s & ((_addr >> 8) + 1), next);
+#define WriteReg_SAX        next = StateWrite(_addr, _a & _x);
+#define WriteReg_SHX        next = StateWrite(_addr, _x & ((_addr >> 8) + 1));
+#define WriteReg_SHY        next = StateWrite(_addr, _y & ((_addr >> 8) + 1));
+#define WriteReg_AHX        next = StateWrite(_addr, _a & _x & ((_addr >> 8) + 1));
+#define WriteReg_TAS        _s = _a & _x; next = StateWrite(_addr, _s & ((_addr >> 8) + 1));
 #define WriteRegZero_SAX    _memory.ram[_addr] = _a & _x;
 
 #define ReadReg         _regs[_selDst] = read(_addr); flagNZ(_regs[_selDst]);
-#define ReadRegCarry    _regs[_selDst] = read(_addr); flagNZ(_regs[_selDst]); _addr += ((std::uint16_t)_addrCarry << 8); if (!_addrCarry) return (&CPU::dispatch);
+#define ReadRegCarry    _regs[_selDst] = read(_addr); flagNZ(_regs[_selDst]); _addr += ((std::uint16_t)_addrCarry << 8); if (!_addrCarry) return StateDispatch;
 #define ReadRegZero     _regs[_selDst] = _memory.ram[_addr]; flagNZ(_regs[_selDst]);
 
 #define ReadReg_AX          _a = _x = read(_addr); flagNZ(_a);
-#define ReadRegCarry_AX     _a = _x = read(_addr); flagNZ(_a); _addr += ((std::uint16_t)_addrCarry << 8); if (!_addrCarry) return (&CPU::dispatch);
+#define ReadRegCarry_AX     _a = _x = read(_addr); flagNZ(_a); _addr += ((std::uint16_t)_addrCarry << 8); if (!_addrCarry) return StateDispatch;
 #define ReadRegZero_AX      _a = _x = _memory.ram[_addr]; flagNZ(_a);
 
 #define ReadReg_LAS         _a = _x = _s = read(_addr) & _s; flagNZ(_s);
-#define ReadRegCarry_LAS    _a = _x = _s = read(_addr) & _s; flagNZ(_s); _addr += ((std::uint16_t)_addrCarry << 8); if (!_addrCarry) return (&CPU::dispatch);
+#define ReadRegCarry_LAS    _a = _x = _s = read(_addr) & _s; flagNZ(_s); _addr += ((std::uint16_t)_addrCarry << 8); if (!_addrCarry) return StateDispatch;
 
 #define CarryFix        _addr += ((std::uint16_t)_addrCarry << 8);
 
@@ -193,8 +201,44 @@
 
 #define Nop             /* nop */;
 #define ReadAddr        read(_addr);
-#define ReadAddrCarry   read(_addr); if (!_addrCarry) return (&CPU::dispatch);
+#define ReadAddrCarry   read(_addr); if (!_addrCarry) return StateDispatch;
 
 #define SwitchPC        _pc = (_addr | ((std::uint16_t)read(_pc) << 8));
 
+namespace libnin
+{
+
+/*
+ * Called between the cycles of a fused instruction, does the per cycle work
+ * of CPU::tick. The last cycle of a run is left for CPU::tick to account.
+ */
+inline bool CPU::fusedStep()
+{
+    if (_cyclesLeft == 1)
+        return false;
+    _odd = !_odd;
+    _scheduler.advance();
+    _cyclesLeft--;
+    if (_scheduler.due())
+        _scheduler.schedule();
+    return true;
+}
+
+/*
+ * Called between the instructions of a compiled block, does the work
+ * CPU::tick and CPU::dispatch would have done before the next opcode.
+ */
+inline bool CPU::aotStep(Handler next, const std::uint8_t* operands)
+{
+    if (!(next == Handler(&CPU::dispatch)) || _nmiPending || _irqPending)
+        return false;
+    if (!fusedStep())
+        return false;
+    _pc++;
+    _operands = operands;
+    return true;
+}
+
+}
+
 #endif
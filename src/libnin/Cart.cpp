@@ -1,5 +1,6 @@
 #include <libnin/Util.h>
 #include <libnin/Cart.h>
+#include <libnin/Tile.h>
 
 using namespace libnin;
 
@@ -11,6 +12,10 @@ void Cart::load(int id, std::uint16_t bankCount, std::FILE* file)
     std::uint32_t bankSize;
 
     delete[] seg.base;
+    delete[] seg.rows;
+    delete[] seg.generations;
+    seg.rows = nullptr;
+    seg.generations = nullptr;
 
     switch (id)
     {
@@ -42,4 +47,16 @@ void Cart::load(int id, std::uint16_t bankCount, std::FILE* file)
     {
         seg.base = new std::uint8_t[size]();
     }
+
+    /* Keep CHR decoded, blank rows decode to zero */
+    if (seg.base && (id == CART_CHR_ROM || id == CART_CHR_RAM))
+    {
+        seg.rows = new std::uint32_t[size / 2]();
+        seg.generations = new std::uint32_t[bankCount]();
+        for (std::uint32_t i = 0; i < size; i += 16)
+        {
+            for (std::uint32_t j = 0; j < 8; ++j)
+                seg.rows[tileRowIndex(i + j)] = tileRow(seg.base[i + j], seg.base[i + j + 8]);
+        }
+    }
 }
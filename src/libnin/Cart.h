@@ -43,10 +43,12 @@ namespace libnin
 
 struct CartSegment : private NonCopyable
 {
-    CartSegment() : base{}, bankCount{} {  }
-    ~CartSegment() { delete[] base; }
+    CartSegment() : base{}, rows{}, generations{}, bankCount{} {  }
+    ~CartSegment() { delete[] base; delete[] rows; delete[] generations; }
 
     std::uint8_t*   base;
+    std::uint32_t*  rows;           /* Decoded tile rows, CHR only */
+    std::uint32_t*  generations;    /* Writes to each bank, CHR only */
     std::uint16_t   bankCount;
 };
 
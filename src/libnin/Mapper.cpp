@@ -1,6 +1,7 @@
 #include <libnin/Mapper.h>
 #include <libnin/Memory.h>
 #include <libnin/Cart.h>
+#include <libnin/Scheduler.h>
 #include <libnin/Util.h>
 
 using namespace libnin;
@@ -12,6 +13,7 @@ Mapper::Mapper(Memory& memory, Cart& cart, Disk& disk, IRQ& irq)
 , _irq{irq}
 , _handleReset{&Mapper::handleReset<MapperID::NROM>}
 , _handleTick{&Mapper::handleTick<MapperID::NROM>}
+, _handleNextEvent{&Mapper::handleNextEvent<MapperID::NROM>}
 , _handleRead{&Mapper::handleRead<MapperID::NROM>}
 , _handleWrite{&Mapper::handleWrite<MapperID::NROM>}
 , _handleVideoRead{&Mapper::handleVideoRead<MapperID::NROM>}
@@ -22,9 +24,26 @@ Mapper::Mapper(Memory& memory, Cart& cart, Disk& disk, IRQ& irq)
 , _prg{}
 , _prgWriteFlag{}
 , _chr{}
+, _chrRows{}
 , _nametables{}
+, _chrGenerations{}
+, _ntGenerations{}
+, _ntRowGenerations{}
+, _readPages{}
+, _writePages{}
+, _videoReadPages{}
+, _videoWritePages{}
+, _readHooks{}
+, _ticking{}
+, _hooksRead{}
+, _hooksVideo{}
 {
-
+    /* The 2KiB of RAM is mirrored up to $1fff */
+    for (int i = 0; i < 0x20; ++i)
+    {
+        _readPages[i] = _memory.ram + (i & 0x07) * 0x100;
+        _writePages[i] = _memory.ram + (i & 0x07) * 0x100;
+    }
 }
 
 NinError Mapper::configure(int mapper, int submapper)
@@ -42,6 +61,9 @@ NinError Mapper::configure(int mapper, int submapper)
         break;
     }
 
+    for (int i = 0; i < 0x100; ++i)
+        _readHooks[i] = false;
+
     mirror(NIN_MIRROR_H);
     bankChr8k(0);
     bankPrg8k(1, CART_PRG_RAM, 0);
@@ -50,15 +72,30 @@ NinError Mapper::configure(int mapper, int submapper)
     bankPrg8k(4, CART_PRG_ROM, -2);
     bankPrg8k(5, CART_PRG_ROM, -1);
     initMatching<MapperID(0)>(mapperID);
+
+    /* Let the scheduler know when it can run the PPU and APU lazily */
+    _ticking = (_handleTick != &Mapper::handleTick<MapperID::NROM>);
+    _hooksRead = (_handleRead != &Mapper::handleRead<MapperID::NROM>);
+
+    /* Same for the PPU, which can render whole lines when fetches have no side effect */
+    _hooksVideo = (_handleVideoRead != &Mapper::handleVideoRead<MapperID::NROM>)
+        || (_handleNtRead != &Mapper::handleNtRead<MapperID::NROM>)
+        || (_handleChrRead != &Mapper::handleChrRead<MapperID::NROM>);
+    updateVideoPages();
     return NIN_OK;
 }
 
 std::uint8_t Mapper::read(std::uint16_t addr)
 {
-    std::uint8_t value = (this->*_handleRead)(addr);
     int slot = ((addr - 0x4000) / 0x2000);
 
-    return _prg[slot] ? _prg[slot][addr & 0x1fff] : value;
+    if (!_prg[slot])
+        return (this->*_handleRead)(addr);
+
+    /* The read handler only matters here for its side effects */
+    if (_readHooks[addr >> 8])
+        (this->*_handleRead)(addr);
+    return _prg[slot][addr & 0x1fff];
 }
 
 void Mapper::write(std::uint16_t addr, std::uint8_t value)
@@ -101,6 +138,33 @@ void Mapper::mirror(int mirrorMode)
         _nametables[3] = _memory.vram + 0x400;
         break;
     }
+    for (int i = 0; i < 4; ++i)
+        _ntGenerations[i] = _ntRowGenerations[(_nametables[i] - _memory.vram) / 0x400];
+    updateVideoPages();
+}
+
+void Mapper::updateVideoPages()
+{
+    bool ntWrite;
+
+    /* Mappers watching the PPU bus see every access */
+    ntWrite = !_hooksVideo && (_handleNtWrite == &Mapper::handleNtWrite<MapperID::NROM>);
+    for (int i = 0; i < 8; ++i)
+    {
+        _videoReadPages[i] = _hooksVideo ? nullptr : _chr[i];
+
+        /* CHR RAM writes also refresh the decoded rows */
+        _videoWritePages[i] = nullptr;
+    }
+    for (int i = 0; i < 8; ++i)
+    {
+        _videoReadPages[8 + i] = _hooksVideo ? nullptr : _nametables[i & 3];
+        _videoWritePages[8 + i] = ntWrite ? _nametables[i & 3] : nullptr;
+    }
+
+    /* $3c00-$3fff also holds the palettes */
+    _videoReadPages[0xf] = nullptr;
+    _videoWritePages[0xf] = nullptr;
 }
 
 void Mapper::bankPrg8k(std::uint8_t slot, int domain, std::int16_t bank)
@@ -117,6 +181,41 @@ void Mapper::bankPrg8k(std::uint8_t slot, int domain, std::int16_t bank)
         _prg[slot] = nullptr;
         _prgWriteFlag[slot] = false;
     }
+    updatePages(slot);
+}
+
+/*
+ * Marks the page holding addr as having read side effects, so the bus keeps
+ * calling the read handler even when PRG is mapped there.
+ */
+void Mapper::hookRead(std::uint16_t addr)
+{
+    _readHooks[addr >> 8] = true;
+    _readPages[addr >> 8] = nullptr;
+}
+
+void Mapper::updatePages(int slot)
+{
+    std::uint8_t* base;
+    int page;
+
+    base = _prg[slot];
+    for (int i = 0; i < 0x20; ++i)
+    {
+        page = 0x40 + slot * 0x20 + i;
+
+        /* $4000-$5fff holds the APU, IO and mapper registers */
+        if (base && slot > 0 && !_readHooks[page])
+            _readPages[page] = base + i * 0x100;
+        else
+            _readPages[page] = nullptr;
+
+        /* Mappers only decode registers from $8000 up, PRG RAM below is plain memory */
+        if (base && slot == 1 && _prgWriteFlag[slot])
+            _writePages[page] = base + i * 0x100;
+        else
+            _writePages[page] = nullptr;
+    }
 }
 
 void Mapper::bankPrg16k(std::uint8_t slot, int domain, std::int16_t bank)
@@ -142,12 +241,17 @@ void Mapper::bankChr1k(std::uint8_t slot, std::int16_t bank)
     {
         bank += segRam.bankCount;
         _chr[slot] = segRam.base + std::uintptr_t(bank % segRam.bankCount) * 0x400;
+        _chrRows[slot] = segRam.rows + std::uintptr_t(bank % segRam.bankCount) * 0x200;
+        _chrGenerations[slot] = segRam.generations + (bank % segRam.bankCount);
     }
     else
     {
         bank += segRom.bankCount;
         _chr[slot] = segRom.base + std::uintptr_t(bank % segRom.bankCount) * 0x400;
+        _chrRows[slot] = segRom.rows + std::uintptr_t(bank % segRom.bankCount) * 0x200;
+        _chrGenerations[slot] = segRom.generations + (bank % segRom.bankCount);
     }
+    updateVideoPages();
 }
 
 void Mapper::bankChr2k(std::uint8_t slot, std::int16_t bank)
@@ -203,6 +307,12 @@ void Mapper::handleTick()
 
 }
 
+template <MapperID id>
+std::size_t Mapper::handleNextEvent()
+{
+    return kNoEvent;
+}
+
 template <MapperID id>
 std::uint8_t Mapper::handleRead(std::uint16_t addr)
 {
@@ -245,5 +355,6 @@ void Mapper::handleChrWrite(int bank, std::uint16_t offset, std::uint8_t value)
     if (_cart.segment(CART_CHR_RAM).base)
     {
         _chr[bank][offset] = value;
+        _chrRows[bank][tileRowIndex(offset)] = tileRow(_chr[bank][offset & ~0x08], _chr[bank][offset | 0x08]);
     }
 }
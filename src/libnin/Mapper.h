@@ -29,6 +29,7 @@
 #ifndef LIBNIN_MAPPER_H
 #define LIBNIN_MAPPER_H 1
 
+#include <cstddef>
 #include <cstdint>
 #include <nin/nin.h>
 #include <libnin/Mapper/DiskSystem.h>
@@ -38,6 +39,7 @@
 #include <libnin/Mapper/MMC5.h>
 #include <libnin/MapperID.h>
 #include <libnin/NonCopyable.h>
+#include <libnin/Tile.h>
 
 #define NIN_MIRROR_A 0
 #define NIN_MIRROR_B 1
@@ -60,17 +62,45 @@ public:
 
     std::uint8_t*       bank(int slot)          { return _prg[slot]; }
     const std::uint8_t* bank(int slot) const    { return _prg[slot]; }
+    bool                bankWritable(int slot) const { return _prgWriteFlag[slot]; }
     std::uint8_t*       chr(int slot)           { return _chr[slot]; }
     const std::uint8_t* chr(int slot) const     { return _chr[slot]; }
 
+    /*
+     * CPU page table, one entry per 256 bytes. A null entry means the bus
+     * must go through the slow path (registers, open bus, mapper hooks).
+     */
+    const std::uint8_t* const*  readPages() const   { return _readPages; }
+    std::uint8_t* const*        writePages() const  { return _writePages; }
+
+    /* Same for the PPU, one entry per KiB */
+    const std::uint8_t* const*  videoReadPages() const  { return _videoReadPages; }
+    std::uint8_t* const*        videoWritePages() const { return _videoWritePages; }
+
+    /*
+     * Write counts of what the background is fetched from, for the line
+     * cache. Each physical nametable has one per tile row (32 bytes), then
+     * one per attribute row (8 bytes), each CHR bank one for its KiB.
+     */
+    static constexpr const int kNtGenerations = 32 + 8;
+
+    const std::uint8_t*     nametable(int slot) const { return _nametables[slot]; }
+    std::uint32_t* const*   ntGenerations() const { return _ntGenerations; }
+    std::uint32_t* const*   chrGenerations() const { return _chrGenerations; }
+
     void            reset() { (this->*_handleReset)(); }
     void            tick() { (this->*_handleTick)(); }
+    bool            ticking() const { return _ticking; }
+    bool            hooksRead() const { return _hooksRead; }
+    bool            hooksVideo() const { return _hooksVideo; }
+    std::size_t     nextEvent() { return (this->*_handleNextEvent)(); }
 
     std::uint8_t    read(std::uint16_t addr);
     void            write(std::uint16_t addr, std::uint8_t value);
     std::uint8_t    ntRead(int bank, std::uint16_t addr) { return (this->*_handleNtRead)(bank, addr); }
     void            ntWrite(int bank, std::uint16_t addr, std::uint8_t value) { (this->*_handleNtWrite)(bank, addr, value); }
     std::uint8_t    chrRead(int bank, std::uint16_t addr) { return (this->*_handleChrRead)(bank, addr); }
+    std::uint32_t   chrRow(std::uint16_t addr) const { return _chrRows[addr >> 10][tileRowIndex(addr & 0x3ff)]; }
     void            chrWrite(int bank, std::uint16_t addr, std::uint8_t value) { (this->*_handleChrWrite)(bank, addr, value); }
 
     void videoRead(std::uint16_t addr) { (this->*_handleVideoRead)(addr); }
@@ -90,6 +120,7 @@ public:
 private:
     using HandlerReset      = void          (Mapper::*)(void);
     using HandlerTick       = void          (Mapper::*)(void);
+    using HandlerNextEvent  = std::size_t   (Mapper::*)(void);
     using HandlerRead       = std::uint8_t  (Mapper::*)(std::uint16_t);
     using HandlerWrite      = void          (Mapper::*)(std::uint16_t, std::uint8_t);
     using HandlerVideoRead  = void          (Mapper::*)(std::uint16_t);
@@ -98,10 +129,15 @@ private:
     using HandlerChrRead    = std::uint8_t  (Mapper::*)(int, std::uint16_t);
     using HandlerChrWrite   = void          (Mapper::*)(int, std::uint16_t, std::uint8_t);
 
+    void hookRead(std::uint16_t addr);
+    void updatePages(int slot);
+    void updateVideoPages();
+
     template <MapperID> void            initMatching(MapperID mapper);
     template <MapperID> void            init();
     template <MapperID> void            handleReset();
     template <MapperID> void            handleTick();
+    template <MapperID> std::size_t     handleNextEvent();
     template <MapperID> std::uint8_t    handleRead(std::uint16_t addr);
     template <MapperID> void            handleWrite(std::uint16_t addr, std::uint8_t value);
     template <MapperID> void            handleVideoRead(std::uint16_t addr);
@@ -117,6 +153,7 @@ private:
 
     HandlerReset        _handleReset;
     HandlerTick         _handleTick;
+    HandlerNextEvent    _handleNextEvent;
     HandlerRead         _handleRead;
     HandlerWrite        _handleWrite;
     HandlerVideoRead    _handleVideoRead;
@@ -128,7 +165,19 @@ private:
     std::uint8_t*   _prg[6];
     bool            _prgWriteFlag[6];
     std::uint8_t*   _chr[8];
+    std::uint32_t*  _chrRows[8];
     std::uint8_t*   _nametables[4];
+    std::uint32_t*  _chrGenerations[8];
+    std::uint32_t*  _ntGenerations[4];
+    std::uint32_t   _ntRowGenerations[2][kNtGenerations];
+    const std::uint8_t* _readPages[0x100];
+    std::uint8_t*       _writePages[0x100];
+    const std::uint8_t* _videoReadPages[0x10];
+    std::uint8_t*       _videoWritePages[0x10];
+    bool                _readHooks[0x100];
+    bool            _ticking:1;
+    bool            _hooksRead:1;
+    bool            _hooksVideo:1;
 
     union
     {
@@ -30,6 +30,7 @@
 #include <libnin/Disk.h>
 #include <libnin/IRQ.h>
 #include <libnin/Mapper.h>
+#include <libnin/Scheduler.h>
 #include <libnin/Util.h>
 
 using namespace libnin;
@@ -359,6 +360,13 @@ void Mapper::handleTick<MapperID::FDS>()
     }
 }
 
+template <>
+std::size_t Mapper::handleNextEvent<MapperID::FDS>()
+{
+    /* Timer and disk transfer IRQs are raised from the mapper clock */
+    return 1;
+}
+
 template <>
 void Mapper::init<MapperID::FDS>()
 {
@@ -366,4 +374,5 @@ void Mapper::init<MapperID::FDS>()
     _handleRead = &Mapper::handleRead<MapperID::FDS>;
     _handleWrite = &Mapper::handleWrite<MapperID::FDS>;
     _handleTick = &Mapper::handleTick<MapperID::FDS>;
+    _handleNextEvent = &Mapper::handleNextEvent<MapperID::FDS>;
 }
@@ -28,6 +28,7 @@
 
 #include <libnin/Cart.h>
 #include <libnin/Mapper.h>
+#include <libnin/Scheduler.h>
 #include <libnin/IRQ.h>
 #include <libnin/Util.h>
 
@@ -150,10 +151,18 @@ void Mapper::handleVideoRead<MapperID::MMC3>(std::uint16_t addr)
     _mmc3.oldVmemAddr = addr;
 }
 
+template <>
+std::size_t Mapper::handleNextEvent<MapperID::MMC3>()
+{
+    /* The scanline counter is clocked by PPU fetches, follow it closely */
+    return _mmc3.irqScanlineEnabled ? 1 : kNoEvent;
+}
+
 template <>
 void Mapper::init<MapperID::MMC3>()
 {
     _handleReset = &Mapper::handleReset<MapperID::MMC3>;
     _handleWrite = &Mapper::handleWrite<MapperID::MMC3>;
     _handleVideoRead = &Mapper::handleVideoRead<MapperID::MMC3>;
+    _handleNextEvent = &Mapper::handleNextEvent<MapperID::MMC3>;
 }
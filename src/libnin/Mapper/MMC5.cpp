@@ -30,6 +30,7 @@
 #include <libnin/IRQ.h>
 #include <libnin/Mapper.h>
 #include <libnin/Memory.h>
+#include <libnin/Scheduler.h>
 #include <libnin/Util.h>
 
 using namespace libnin;
@@ -389,6 +390,12 @@ std::uint8_t Mapper::handleChrRead<MapperID::MMC5>(int bank, std::uint16_t offse
     return _chr[bank][offset];
 }
 
+template <>
+std::size_t Mapper::handleNextEvent<MapperID::MMC5>()
+{
+    return _mmc5.scanlineEnabled ? 1 : kNoEvent;
+}
+
 template <>
 void Mapper::init<MapperID::MMC5>()
 {
@@ -400,4 +407,8 @@ void Mapper::init<MapperID::MMC5>()
     _handleNtRead = &Mapper::handleNtRead<MapperID::MMC5>;
     _handleNtWrite = &Mapper::handleNtWrite<MapperID::MMC5>;
     _handleChrRead = &Mapper::handleChrRead<MapperID::MMC5>;
+    _handleNextEvent = &Mapper::handleNextEvent<MapperID::MMC5>;
+
+    /* Fetching the NMI vector ends the frame */
+    hookRead(0xfffa);
 }
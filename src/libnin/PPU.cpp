@@ -26,6 +26,7 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <cmath>
@@ -35,36 +36,14 @@
 #include <libnin/Mapper.h>
 #include <libnin/Memory.h>
 #include <libnin/NMI.h>
+#include <libnin/Scheduler.h>
+#include <libnin/Tile.h>
 #include <libnin/Video.h>
 
 using namespace libnin;
 
-static constexpr std::uint8_t bitrev8(std::uint8_t v)
-{
-    alignas(64) constexpr const std::uint8_t kLookup[] =
-    {
-        0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0, 0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0,
-        0x08, 0x88, 0x48, 0xc8, 0x28, 0xa8, 0x68, 0xe8, 0x18, 0x98, 0x58, 0xd8, 0x38, 0xb8, 0x78, 0xf8,
-        0x04, 0x84, 0x44, 0xc4, 0x24, 0xa4, 0x64, 0xe4, 0x14, 0x94, 0x54, 0xd4, 0x34, 0xb4, 0x74, 0xf4,
-        0x0c, 0x8c, 0x4c, 0xcc, 0x2c, 0xac, 0x6c, 0xec, 0x1c, 0x9c, 0x5c, 0xdc, 0x3c, 0xbc, 0x7c, 0xfc,
-        0x02, 0x82, 0x42, 0xc2, 0x22, 0xa2, 0x62, 0xe2, 0x12, 0x92, 0x52, 0xd2, 0x32, 0xb2, 0x72, 0xf2,
-        0x0a, 0x8a, 0x4a, 0xca, 0x2a, 0xaa, 0x6a, 0xea, 0x1a, 0x9a, 0x5a, 0xda, 0x3a, 0xba, 0x7a, 0xfa,
-        0x06, 0x86, 0x46, 0xc6, 0x26, 0xa6, 0x66, 0xe6, 0x16, 0x96, 0x56, 0xd6, 0x36, 0xb6, 0x76, 0xf6,
-        0x0e, 0x8e, 0x4e, 0xce, 0x2e, 0xae, 0x6e, 0xee, 0x1e, 0x9e, 0x5e, 0xde, 0x3e, 0xbe, 0x7e, 0xfe,
-        0x01, 0x81, 0x41, 0xc1, 0x21, 0xa1, 0x61, 0xe1, 0x11, 0x91, 0x51, 0xd1, 0x31, 0xb1, 0x71, 0xf1,
-        0x09, 0x89, 0x49, 0xc9, 0x29, 0xa9, 0x69, 0xe9, 0x19, 0x99, 0x59, 0xd9, 0x39, 0xb9, 0x79, 0xf9,
-        0x05, 0x85, 0x45, 0xc5, 0x25, 0xa5, 0x65, 0xe5, 0x15, 0x95, 0x55, 0xd5, 0x35, 0xb5, 0x75, 0xf5,
-        0x0d, 0x8d, 0x4d, 0xcd, 0x2d, 0xad, 0x6d, 0xed, 0x1d, 0x9d, 0x5d, 0xdd, 0x3d, 0xbd, 0x7d, 0xfd,
-        0x03, 0x83, 0x43, 0xc3, 0x23, 0xa3, 0x63, 0xe3, 0x13, 0x93, 0x53, 0xd3, 0x33, 0xb3, 0x73, 0xf3,
-        0x0b, 0x8b, 0x4b, 0xcb, 0x2b, 0xab, 0x6b, 0xeb, 0x1b, 0x9b, 0x5b, 0xdb, 0x3b, 0xbb, 0x7b, 0xfb,
-        0x07, 0x87, 0x47, 0xc7, 0x27, 0xa7, 0x67, 0xe7, 0x17, 0x97, 0x57, 0xd7, 0x37, 0xb7, 0x77, 0xf7,
-        0x0f, 0x8f, 0x4f, 0xcf, 0x2f, 0xaf, 0x6f, 0xef, 0x1f, 0x9f, 0x5f, 0xdf, 0x3f, 0xbf, 0x7f, 0xff,
-    };
-
-    return kLookup[v];
-}
-
 static const uint16_t kHMask = 0x041f;
+static const std::uint32_t kFrameDots = 341 * 262;
 
 static std::uint16_t incX(std::uint16_t v)
 {
@@ -138,18 +117,24 @@ PPU::PPU(HardwareInfo& info, Memory& memory, NMI& nmi, BusVideo& busVideo, Mappe
 , _dummySkip{}
 , _nmiRace{}
 , _nmiSup{}
+, _oamDirty{true}
+, _lineCacheEnabled{}
 , _flags{}
+, _spriteLines{}
+, _spriteLinesCount{}
 , _readBuf{}
 , _latchNT{}
 , _latchAT{}
 , _latchLoBG{}
 , _latchHiBG{}
-, _shiftPatternLo{}
-, _shiftPatternHi{}
+, _shiftPattern{}
 , _shiftPaletteLo{}
 , _shiftPaletteHi{}
+, _spriteLine{}
+, _lineCache{}
 , _clock{}
 , _clockVideo{}
+, _clockFrame{341 * 21 - 2}
 , _scanline{}
 , _step{}
 , _oamAddr{}
@@ -220,6 +205,8 @@ void PPU::regWrite(std::uint16_t reg, std::uint8_t value)
         _flags.incrementY = !!(value & 0x04);
         _flags.altSpritePattern = !!(value & 0x08);
         _flags.altBackgroundPattern = !!(value & 0x10);
+        if (_flags.largeSprites != !!(value & 0x20))
+            _oamDirty = true;
         _flags.largeSprites = !!(value & 0x20);
 
         if (value & 0x80)
@@ -293,17 +280,94 @@ void PPU::regWrite(std::uint16_t reg, std::uint8_t value)
 void PPU::oamWrite(std::uint8_t value)
 {
     _memory.oam[_oamAddr++] = value;
+    _oamDirty = true;
 }
 
 void PPU::tick(std::size_t cycles)
 {
-    while (cycles--)
+    std::size_t skip;
+
+    while (cycles)
     {
+        /* Waiting dots only count down, once the last pixels are out take them all at once */
+        if (_handler == Handler(&PPU::handleWait) && !_pixelBufferBits)
+        {
+            skip = std::min<std::size_t>(_clock, cycles);
+            _clock -= std::uint32_t(skip);
+            _clockFrame += std::uint32_t(skip);
+            cycles -= skip;
+            if (!cycles)
+                break;
+        }
+
+        /*
+         * The CPU syncs before touching the PPU or the mapper, so when the
+         * whole line and its last two pixels fit in the run, nothing can
+         * change or observe it mid-line.
+         */
+        if (_handler == Handler(&PPU::handleScan) && cycles >= 259 && !_pixelBufferBits && !_mapper.hooksVideo())
+        {
+            renderLine();
+            _handler = &PPU::handleScanSpriteEval;
+            _clockFrame += 257;
+            cycles -= 257;
+            continue;
+        }
         _handler = (Handler)(this->*_handler)();
         processPixel();
+        _clockFrame++;
+        cycles--;
     }
 }
 
+std::size_t PPU::nextEvent() const
+{
+    if (!_nmi.check(NMI_OUTPUT))
+        return kNoEvent;
+    return nextFrame();
+}
+
+std::size_t PPU::nextFrame() const
+{
+    std::size_t dots;
+
+    /* Odd frames can be one dot short, so assume they all are */
+    if (_clockFrame >= kFrameDots - 1)
+        return 1;
+    dots = kFrameDots - _clockFrame;
+    return (dots + 2) / 3;
+}
+
+/*
+ * Tells whether reading PPUSTATUS right now would have no side effect, and
+ * what it would return.
+ */
+bool PPU::statusStable(std::uint8_t* value) const
+{
+    if (_w || _nmiRace || _nmi.check(NMI_OCCURED))
+        return false;
+    *value = _spriteZeroHit ? 0x40 : 0x00;
+    return true;
+}
+
+/*
+ * Returns a lower bound of the CPU cycles left before PPUSTATUS may change.
+ */
+std::size_t PPU::statusEvent() const
+{
+    std::uint32_t dots;
+
+    if (_clockFrame < 341 * 20 - 2)
+        dots = 341 * 20 - 2 - _clockFrame;
+    else if (_flags.backgroundEnable && _flags.spriteEnable && !_spriteZeroHit)
+        return 0;
+    else if (_clockFrame < kFrameDots - 3)
+        dots = kFrameDots - 3 - _clockFrame;
+    else
+        return 0;
+    return dots / 3;
+}
+
 void PPU::processPixel()
 {
     std::uint8_t mask;
@@ -340,6 +404,7 @@ PPU::Handler PPU::handleVBlank1()
     _nmiSup = false;
     _video.swap();
     _clockVideo = 0;
+    _clockFrame = 0;
     return wait(341 * 20 - 1, (Handler)&PPU::handlePreScan);
 }
 
@@ -349,11 +414,7 @@ PPU::Handler PPU::handlePreScan()
     _prescan = true;
     _spriteZeroNext = false;
     _spriteZeroHit = false;
-    for (int i = 0; i < 8; ++i)
-    {
-        _shiftSpriteHi[i] = 0x00;
-        _shiftSpriteLo[i] = 0x00;
-    }
+    std::memset(_spriteLine, 0, sizeof(_spriteLine));
     _step = 0;
     return wait(255, (Handler)&PPU::handlePreScanReloadX);
 }
@@ -385,6 +446,7 @@ PPU::Handler PPU::handlePreScanReloadY()
 
 PPU::Handler PPU::handleScan()
 {
+    _video.emphasis(_scanline, emphasis());
     _step = 0;
     return &PPU::handleScanNT0;
 }
@@ -550,7 +612,13 @@ PPU::Handler PPU::handleNextDummy3()
         _scanline = 0;
         _step = 0;
         _oddFrame = !_oddFrame;
-        return _dummySkip ? &PPU::handleScanNT0 : &PPU::handleScan;
+        if (_dummySkip)
+        {
+            /* The skipped dot is where handleScan latches the emphasis */
+            _video.emphasis(0, emphasis());
+            return &PPU::handleScanNT0;
+        }
+        return &PPU::handleScan;
     }
     if (_scanline + 1 < 240)
     {
@@ -601,40 +669,225 @@ void PPU::fetchAT()
 
 void PPU::fetchLoBG()
 {
-    _latchLoBG = _busVideo.read((_flags.altBackgroundPattern ? 0x1000 : 0x0000) | _latchNT << 4 | ((_v >> 12) & 0x07));
+    _latchLoBG = _busVideo.read(addrBG());
 }
 
 void PPU::fetchHiBG()
 {
-    _latchHiBG = _busVideo.read((_flags.altBackgroundPattern ? 0x1000 : 0x0000) | _latchNT << 4 | 0x08 | ((_v >> 12) & 0x07));
+    _latchHiBG = _busVideo.read(addrBG() | 0x08);
+}
+
+std::uint16_t PPU::addrBG() const
+{
+    return (_flags.altBackgroundPattern ? 0x1000 : 0x0000) | _latchNT << 4 | ((_v >> 12) & 0x07);
+}
+
+/*
+ * Runs dots 0 to 256 of a visible scanline, like the handleScan handlers,
+ * but pixels go straight to the video output.
+ */
+void PPU::renderLine()
+{
+    LineCache* cache;
+    std::uint8_t mask;
+    std::uint8_t bg;
+    std::uint8_t sprite;
+    bool hit;
+
+    _video.emphasis(_scanline, emphasis());
+    mask = _flags.grayscale ? 0x30 : 0x3f;
+
+    cache = nullptr;
+    hit = false;
+    if (_lineCacheEnabled && _video.enabled())
+    {
+        cache = _lineCache + _scanline;
+        hit = lineCacheHit(*cache);
+        if (!hit)
+        {
+            cache->valid = false;
+            lineSources(cache->sources);
+            cache->shiftPattern = _shiftPattern;
+            cache->shiftPaletteLo = _shiftPaletteLo;
+            cache->shiftPaletteHi = _shiftPaletteHi;
+            cache->v = _v;
+            cache->t = _t;
+            cache->x = _x;
+            cache->x2 = _x2;
+            cache->flags = lineCacheFlags();
+        }
+    }
+
+    for (_step = 0; _step < 32; ++_step)
+    {
+        if (!_video.enabled())
+        {
+            /* Eight dots leave _x2 where it was */
+            if (_spriteZeroNext)
+            {
+                for (int i = 0; i < 8; ++i)
+                    spriteZeroPixel();
+            }
+        }
+        else
+        {
+            for (int i = 0; i < 8; ++i)
+            {
+                if (hit)
+                    bg = cache->bg[_step * 8 + i];
+                else
+                {
+                    bg = 0x00;
+                    if (_flags.backgroundEnable && (_step || _flags.backgroundEnableLeft))
+                        bg = pixelBackground();
+                    if (cache)
+                        cache->bg[_step * 8 + i] = bg;
+                }
+
+                sprite = 0x00;
+                if (_flags.spriteEnable && (_step || _flags.spriteEnableLeft))
+                    sprite = pixelSprite(bg);
+                _x2 = (_x2 + 1) & 0x07;
+
+                _video.write(_clockVideo++, _memory.palettes[sprite ? (0x10 | sprite) : bg] & mask);
+            }
+        }
+
+        /* Pattern fetches have no side effect here, take the decoded row */
+        if (!hit)
+        {
+            fetchNT();
+            fetchAT();
+            shiftLoad(std::uint16_t(_mapper.chrRow(addrBG())));
+            if (_flags.rendering)
+                _v = incX(_v);
+        }
+    }
+    _step = 0;
+
+    if (hit)
+    {
+        _v = cache->endV;
+        _latchNT = cache->endLatchNT;
+        _latchAT = cache->endLatchAT;
+        _shiftPattern = cache->endShiftPattern;
+        _shiftPaletteLo = cache->endShiftPaletteLo;
+        _shiftPaletteHi = cache->endShiftPaletteHi;
+        return;
+    }
+
+    if (_flags.rendering)
+    {
+        _v = copyX(_v, _t);
+        _v = incY(_v);
+    }
+    if (cache)
+    {
+        cache->valid = true;
+        cache->endV = _v;
+        cache->endLatchNT = _latchNT;
+        cache->endLatchAT = _latchAT;
+        cache->endShiftPattern = _shiftPattern;
+        cache->endShiftPaletteLo = _shiftPaletteLo;
+        cache->endShiftPaletteHi = _shiftPaletteHi;
+    }
+}
+
+/*
+ * Palettes are applied after the cache, so only writes to the fetched
+ * nametable row or CHR banks, bank switches and the scroll state can change
+ * a cached background.
+ */
+bool PPU::lineCacheHit(const LineCache& line) const
+{
+    LineSources sources;
+
+    if (!line.valid)
+        return false;
+    lineSources(sources);
+    return std::memcmp(&line.sources, &sources, sizeof(sources)) == 0
+        && line.shiftPattern == _shiftPattern
+        && line.shiftPaletteLo == _shiftPaletteLo
+        && line.shiftPaletteHi == _shiftPaletteHi
+        && line.v == _v
+        && line.t == _t
+        && line.x == _x
+        && line.x2 == _x2
+        && line.flags == lineCacheFlags();
+}
+
+/*
+ * A line reads one tile row across two horizontal nametables, the
+ * attribute row above it, and the four banks of its pattern table.
+ */
+void PPU::lineSources(LineSources& sources) const
+{
+    const std::uint32_t* generations;
+    int slot;
+    int row;
+    int bank;
+
+    slot = (_v >> 10) & 3;
+    row = (_v >> 5) & 0x1f;
+    bank = _flags.altBackgroundPattern ? 4 : 0;
+    for (int i = 0; i < 2; ++i)
+    {
+        generations = _mapper.ntGenerations()[slot ^ i];
+        sources.nametables[i] = _mapper.nametable(slot ^ i);
+        sources.ntGenerations[i * 2 + 0] = generations[row];
+        sources.ntGenerations[i * 2 + 1] = generations[32 + (row >> 2)];
+    }
+    for (int i = 0; i < 4; ++i)
+    {
+        sources.chr[i] = _mapper.chr(bank + i);
+        sources.chrGenerations[i] = *_mapper.chrGenerations()[bank + i];
+    }
+}
+
+std::uint8_t PPU::lineCacheFlags() const
+{
+    return _flags.backgroundEnable
+        | (_flags.backgroundEnableLeft << 1)
+        | (_flags.altBackgroundPattern << 2)
+        | (_flags.rendering << 3);
 }
 
 void PPU::spriteEvaluation()
 {
-    std::uint16_t y;
-    std::uint8_t spriteHeight;
+    const std::uint8_t* line;
 
-    _oam2Count = 0;
-    _spriteZeroNext = false;
+    if (_oamDirty)
+        spriteIndex();
 
-    std::memset(_oam2, 0xff, 32);
-    spriteHeight = _flags.largeSprites ? 16 : 8;
+    line = _spriteLines[_scanline];
+    _oam2Count = _spriteLinesCount[_scanline];
+    _spriteZeroNext = (_oam2Count && line[0] == 0);
+    for (int i = 0; i < _oam2Count; ++i)
+        std::memcpy(_oam2[i].raw, _memory.oam + line[i] * 4, 4);
+}
+
+/*
+ * Lists the sprites in range of every visible line, in OAM order and up to
+ * eight per line, so that evaluation is a lookup as long as OAM and the
+ * sprite size do not change.
+ */
+void PPU::spriteIndex()
+{
+    unsigned y;
+    unsigned end;
+
+    std::memset(_spriteLinesCount, 0, sizeof(_spriteLinesCount));
     for (int i = 0; i < 64; ++i)
     {
         y = _memory.oam[4 * i];
-        if (_scanline >= y && _scanline < y + spriteHeight)
+        end = std::min(y + (_flags.largeSprites ? 16 : 8), 240u);
+        for (; y < end; ++y)
         {
-            // Sprite y-hit
-            if (i == 0)
-            {
-                _spriteZeroNext = true;
-            }
-            memcpy(_oam2[_oam2Count].raw, _memory.oam + i * 4, 4);
-            _oam2Count++;
-            if (_oam2Count == 8)
-                break;
+            if (_spriteLinesCount[y] < 8)
+                _spriteLines[y][_spriteLinesCount[y]++] = i;
         }
     }
+    _oamDirty = false;
 }
 
 void PPU::spriteFetch()
@@ -643,9 +896,13 @@ void PPU::spriteFetch()
     std::uint16_t tile;
     std::uint16_t nametable;
     std::uint16_t addr;
+    std::uint32_t row;
+    std::uint8_t lo;
+    std::uint8_t hi;
 
     int i;
 
+    std::memset(_spriteLine, 0, sizeof(_spriteLine));
     for (i = 0; i < _oam2Count; ++i)
     {
         y = _scanline - _oam2[i].y;
@@ -676,24 +933,51 @@ void PPU::spriteFetch()
 
         addr = nametable | (tile << 4) | y;
 
-        _shiftSpriteX[i] = _oam2[i].x;
-        _shiftSpriteAttr[i] = _oam2[i].raw[2];
-        _shiftSpriteLo[i] = _busVideo.read(addr | 0x00);
-        _shiftSpriteHi[i] = _busVideo.read(addr | 0x08);
+        if (_mapper.hooksVideo())
+        {
+            lo = _busVideo.read(addr | 0x00);
+            hi = _busVideo.read(addr | 0x08);
+            row = tileRow(lo, hi);
+        }
+        else
+            row = _mapper.chrRow(addr);
+        spriteDraw(i, row);
     }
 
     for (; i < 8; ++i)
     {
-        _shiftSpriteX[i] = 0;
-        _shiftSpriteAttr[i] = 0;
-        _shiftSpriteLo[i] = 0;
-        _shiftSpriteHi[i] = 0;
-
         _mapper.videoRead(0x1000);
         _mapper.videoRead(0x1000);
     }
 }
 
+/*
+ * Composes a fetched sprite into the line buffer. Sprites come in OAM order
+ * and the lowest index wins, so opaque pixels already drawn are kept.
+ */
+void PPU::spriteDraw(int i, std::uint32_t row)
+{
+    std::uint8_t entry;
+    std::uint8_t pattern;
+    unsigned x;
+
+    entry = _oam2[i].palette << 2;
+    if (_oam2[i].back)
+        entry |= 0x20;
+    if (i == 0 && _spriteZeroNext)
+        entry |= 0x40;
+    if (_oam2[i].xFlip)
+        row >>= 16;
+    for (int j = 0; j < 8; ++j)
+    {
+        x = _oam2[i].x + j;
+        if (x > 255)
+            break;
+        pattern = (row >> (j * 2)) & 0x03;
+        if (pattern && !_spriteLine[x])
+            _spriteLine[x] = entry | pattern;
+    }
+}
 
 void PPU::emitPixel()
 {
@@ -702,6 +986,12 @@ void PPU::emitPixel()
     std::uint8_t sprite;
     //std::uint8_t mask;
 
+    if (!_video.enabled())
+    {
+        spriteZeroPixel();
+        return;
+    }
+
     if (_flags.backgroundEnable && (_step || _flags.backgroundEnableLeft))
     {
         bg = pixelBackground();
@@ -728,6 +1018,14 @@ void PPU::emitPixel()
     _pixelBufferBits |= (0x01 << 2);
 }
 
+/* Headless frames compose nothing, but games still observe sprite zero hits */
+void PPU::spriteZeroPixel()
+{
+    if ((_spriteLine[_step * 8 + _x2] & 0x40) && _flags.backgroundEnable && _flags.spriteEnable && (_step || (_flags.backgroundEnableLeft && _flags.spriteEnableLeft)))
+        pixelSprite(pixelBackground());
+    _x2 = (_x2 + 1) & 0x07;
+}
+
 std::uint8_t PPU::pixelBackground()
 {
     std::uint8_t shift;
@@ -737,8 +1035,7 @@ std::uint8_t PPU::pixelBackground()
 
     shift = _x + _x2;
 
-    pattern |= ((_shiftPatternLo >> shift) & 0x01);
-    pattern |= (((_shiftPatternHi >> shift) & 0x01) << 1);
+    pattern = (_shiftPattern >> (shift * 2)) & 0x03;
     palette |= ((_shiftPaletteLo >> shift) & 0x01);
     palette |= (((_shiftPaletteHi >> shift) & 0x01) << 1);
 
@@ -752,53 +1049,32 @@ std::uint8_t PPU::pixelBackground()
 
 std::uint8_t PPU::pixelSprite(std::uint8_t bg)
 {
-    std::uint16_t scanX;
-    std::uint16_t spriteX;
-    std::uint8_t pattern;
-    std::uint8_t shift;
+    std::uint8_t scanX;
+    std::uint8_t entry;
 
     scanX = _step * 8 + _x2;
-
-    for (int i = 0; i < 8; ++i)
-    {
-        spriteX = _shiftSpriteX[i];
-        if (scanX >= spriteX && scanX < spriteX + 8)
-        {
-            shift = scanX - spriteX;
-            if (!(_shiftSpriteAttr[i] & 0x40)) // X Flip
-            {
-                shift = 7 - shift;
-            }
-            pattern = 0;
-            pattern |= (_shiftSpriteLo[i] >> shift) & 0x01;
-            pattern |= ((_shiftSpriteHi[i] >> shift) & 0x01) << 1;
-            if (pattern)
-            {
-                if (_spriteZeroNext && i == 0 && bg && !(_step == 31 && _x2 == 7))
-                {
-                    _spriteZeroHit = true;
-                }
-                if (bg && _shiftSpriteAttr[i] & 0x20)
-                {
-                    return 0;
-                }
-                return ((_shiftSpriteAttr[i] & 0x03) << 2) | pattern;
-            }
-        }
-    }
-
-    return 0;
+    entry = _spriteLine[scanX];
+    if (!entry)
+        return 0;
+    if ((entry & 0x40) && bg && scanX != 255)
+        _spriteZeroHit = true;
+    if (bg && (entry & 0x20))
+        return 0;
+    return entry & 0x0f;
 }
 
 void PPU::shiftReload()
 {
-    _shiftPatternLo >>= 8;
-    _shiftPatternHi >>= 8;
+    shiftLoad(std::uint16_t(tileRow(_latchLoBG, _latchHiBG)));
+}
+
+void PPU::shiftLoad(std::uint16_t row)
+{
+    _shiftPattern >>= 16;
     _shiftPaletteLo >>= 8;
     _shiftPaletteHi >>= 8;
 
-    _shiftPatternLo |= (std::uint16_t)bitrev8(_latchLoBG) << 8;
-    _shiftPatternHi |= (std::uint16_t)bitrev8(_latchHiBG) << 8;
+    _shiftPattern |= std::uint32_t(row) << 16;
     _shiftPaletteLo |= (_latchAT & 0x01) ? 0xff00 : 0x0000;
     _shiftPaletteHi |= (_latchAT & 0x02) ? 0xff00 : 0x0000;
 }
@@ -54,6 +54,11 @@ public:
 
     void            tick(std::size_t cycles);
     void            processPixel();
+    std::size_t     nextEvent() const;
+    std::size_t     nextFrame() const;
+    bool            statusStable(std::uint8_t* value) const;
+    std::size_t     statusEvent() const;
+    void            setLineCache(bool enabled) { _lineCacheEnabled = enabled; }
 
 private:
     union Sprite
@@ -89,6 +94,43 @@ private:
         bool emphasisBlue:1;
     };
 
+    /*
+     * The nametable row and CHR banks a line fetches its background from,
+     * with their write counts at the time.
+     */
+    struct LineSources
+    {
+        const std::uint8_t* nametables[2];
+        const std::uint8_t* chr[4];
+        std::uint32_t       ntGenerations[4];
+        std::uint32_t       chrGenerations[4];
+    };
+
+    /*
+     * Background pixels of each line, with the state they were rendered
+     * from and the state they left behind, reused while neither changes.
+     */
+    struct LineCache
+    {
+        bool            valid;
+        LineSources     sources;
+        std::uint32_t   shiftPattern;
+        std::uint16_t   shiftPaletteLo;
+        std::uint16_t   shiftPaletteHi;
+        std::uint16_t   v;
+        std::uint16_t   t;
+        std::uint8_t    x;
+        std::uint8_t    x2;
+        std::uint8_t    flags;
+        std::uint8_t    endLatchNT;
+        std::uint8_t    endLatchAT;
+        std::uint16_t   endV;
+        std::uint32_t   endShiftPattern;
+        std::uint16_t   endShiftPaletteLo;
+        std::uint16_t   endShiftPaletteHi;
+        std::uint8_t    bg[256];
+    };
+
     using Handler = MemberStateHelper<PPU>;
 
     Handler handleWait();
@@ -128,15 +170,26 @@ private:
     void fetchAT();
     void fetchLoBG();
     void fetchHiBG();
+    std::uint16_t addrBG() const;
+
+    void renderLine();
+    bool lineCacheHit(const LineCache& line) const;
+    void lineSources(LineSources& sources) const;
+    std::uint8_t lineCacheFlags() const;
 
     void spriteEvaluation();
+    void spriteIndex();
     void spriteFetch();
+    void spriteDraw(int i, std::uint32_t row);
 
     void            emitPixel();
     std::uint8_t    pixelBackground();
     std::uint8_t    pixelSprite(std::uint8_t bg);
+    void            spriteZeroPixel();
+    std::uint8_t    emphasis() const { return _flags.emphasisRed | (_flags.emphasisGreen << 1) | (_flags.emphasisBlue << 2); }
 
     void shiftReload();
+    void shiftLoad(std::uint16_t row);
 
     HardwareInfo&   _info;
     Memory&         _memory;
@@ -160,29 +213,35 @@ private:
     bool            _dummySkip:1;
     bool            _nmiRace:1;
     bool            _nmiSup:1;
+    bool            _oamDirty:1;
+    bool            _lineCacheEnabled:1;
 
     Flags           _flags;
     Sprite          _oam2[8];
     std::uint8_t    _oam2Count;
 
+    /* Sprites in range of each visible line, rebuilt when _oamDirty is set */
+    std::uint8_t    _spriteLines[240][8];
+    std::uint8_t    _spriteLinesCount[240];
+
     std::uint8_t    _readBuf;
     std::uint8_t    _latchNT;
     std::uint8_t    _latchAT;
     std::uint8_t    _latchLoBG;
     std::uint8_t    _latchHiBG;
 
-    std::uint16_t   _shiftPatternLo;
-    std::uint16_t   _shiftPatternHi;
+    std::uint32_t   _shiftPattern;     /* Two decoded tile rows, 2 bits per pixel */
     std::uint16_t   _shiftPaletteLo;
     std::uint16_t   _shiftPaletteHi;
 
-    std::uint8_t    _shiftSpriteX[8];
-    std::uint8_t    _shiftSpriteAttr[8];
-    std::uint8_t    _shiftSpriteLo[8];
-    std::uint8_t    _shiftSpriteHi[8];
+    /* Sprites of the current line: palette index, 0x20 behind bg, 0x40 sprite zero */
+    std::uint8_t    _spriteLine[256];
+
+    LineCache       _lineCache[240];
 
     std::uint32_t   _clock;
     std::uint32_t   _clockVideo;
+    std::uint32_t   _clockFrame;    /* Dots since VBlank, power-on is 241 lines and 2 dots before it */
     std::uint8_t    _scanline;
     std::uint8_t    _step;
     std::uint8_t    _oamAddr;
@@ -0,0 +1,61 @@
+#include <algorithm>
+#include <libnin/APU.h>
+#include <libnin/Mapper.h>
+#include <libnin/PPU.h>
+#include <libnin/Scheduler.h>
+
+using namespace libnin;
+
+Scheduler::Scheduler(PPU& ppu, APU& apu, Mapper& mapper)
+: _ppu{ppu}
+, _apu{apu}
+, _mapper{mapper}
+, _cycle{}
+, _synced{}
+, _deadline{}
+{
+
+}
+
+void Scheduler::sync()
+{
+    catchUp();
+
+    /* The caller is about to touch a register, so the deadline may be stale */
+    _deadline = _cycle;
+}
+
+void Scheduler::schedule()
+{
+    std::size_t next;
+
+    catchUp();
+    next = _ppu.nextEvent();
+    next = std::min(next, _apu.nextEvent());
+    next = std::min(next, _mapper.nextEvent());
+    _deadline = _synced + next;
+}
+
+void Scheduler::catchUp()
+{
+    std::size_t cycles;
+
+    cycles = std::size_t(_cycle - _synced);
+    _synced = _cycle;
+
+    if (_mapper.ticking())
+    {
+        /* Mappers with a clock watch the PPU bus every cycle, keep them interleaved */
+        for (std::size_t i = 0; i < cycles; ++i)
+        {
+            _ppu.tick(3);
+            _apu.tick(1);
+            _mapper.tick();
+        }
+    }
+    else
+    {
+        _ppu.tick(cycles * 3);
+        _apu.tick(cycles);
+    }
+}
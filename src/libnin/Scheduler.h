@@ -0,0 +1,48 @@
+#ifndef LIBNIN_SCHEDULER_H
+#define LIBNIN_SCHEDULER_H 1
+
+#include <cstddef>
+#include <cstdint>
+#include <libnin/NonCopyable.h>
+
+namespace libnin
+{
+
+/*
+ * Returned by nextEvent() when a component cannot change an interrupt line
+ * until the CPU touches one of its registers.
+ */
+constexpr const std::size_t kNoEvent = 0x10000000;
+
+class PPU;
+class APU;
+class Mapper;
+class Scheduler : private NonCopyable
+{
+public:
+    Scheduler(PPU& ppu, APU& apu, Mapper& mapper);
+
+    std::uint64_t   cycle() const { return _cycle; }
+    std::uint64_t   deadline() const { return _deadline; }
+    bool            due() const { return _cycle >= _deadline; }
+
+    void advance() { _cycle++; }
+    void skip(std::size_t cycles) { _cycle += cycles; }
+    void sync();
+    void schedule();
+
+private:
+    void catchUp();
+
+    PPU&            _ppu;
+    APU&            _apu;
+    Mapper&         _mapper;
+
+    std::uint64_t   _cycle;
+    std::uint64_t   _synced;
+    std::uint64_t   _deadline;
+};
+
+}
+
+#endif
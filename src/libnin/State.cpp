@@ -149,8 +149,9 @@ State::State()
 , audio{info}
 , apu{info, irq, mapper, audio}
 , ppu{info, memory, nmi, busVideo, mapper, video}
-, busMain{memory, cart, mapper, ppu, apu, input}
-, cpu{memory, irq, nmi, ppu, apu, busMain}
+, scheduler{ppu, apu, mapper}
+, busMain{memory, cart, mapper, ppu, apu, input, scheduler}
+, cpu{memory, irq, nmi, ppu, apu, cart, mapper, busMain, scheduler}
 {
 
 }
@@ -47,6 +47,7 @@
 #include <libnin/NonCopyable.h>
 #include <libnin/PPU.h>
 #include <libnin/Save.h>
+#include <libnin/Scheduler.h>
 #include <libnin/Util.h>
 #include <libnin/Video.h>
 
@@ -88,6 +89,7 @@ public:
     Audio           audio;
     APU             apu;
     PPU             ppu;
+    Scheduler       scheduler;
     BusMain         busMain;
     CPU             cpu;
 };
@@ -0,0 +1,61 @@
+/*
+ * BSD 2 - Clause License
+ *
+ * Copyright(c) 2019, Maxime Bacoux
+ * All rights reserved.
+ *
+ * Redistributionand use in sourceand binary forms, with or without
+ * modification, are permitted provided that the following conditions are met :
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditionsand the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditionsand the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LIBNIN_TILE_H
+#define LIBNIN_TILE_H 1
+
+#include <cstdint>
+
+namespace libnin
+{
+
+extern const std::uint16_t kTileSpread[256];
+extern const std::uint16_t kTileSpreadReverse[256];
+
+/*
+ * Decodes a row of pattern data into 8 pixels of 2 bits each, leftmost
+ * pixel in the low bits, with the horizontally flipped row in the upper half.
+ */
+inline std::uint32_t tileRow(std::uint8_t lo, std::uint8_t hi)
+{
+    std::uint32_t row;
+
+    row = kTileSpreadReverse[lo] | (kTileSpreadReverse[hi] << 1);
+    row |= std::uint32_t(kTileSpread[lo] | (kTileSpread[hi] << 1)) << 16;
+    return row;
+}
+
+/* Index of the decoded row holding the pattern byte at offset */
+inline std::uint32_t tileRowIndex(std::uint32_t offset)
+{
+    return ((offset >> 1) & ~7u) | (offset & 7);
+}
+
+}
+
+#endif
@@ -27,6 +27,9 @@
  */
 
 #include <cstring>
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
 #include <libnin/Video.h>
 
 using namespace libnin;
@@ -52,22 +55,363 @@ const uint32_t Video::kPalette[] = {
 };
 
 Video::Video()
-: _buffer0{}
-, _buffer1{}
-, _frontBuffer{_buffer0}
-, _backBuffer{_buffer1}
+: _palette{}
+, _paletteBGRA{}
+, _palette565{}
+, _paletteY{}
+, _paletteU{}
+, _paletteV{}
+, _frames{}
+, _front{_frames + 0}
+, _back{_frames + 1}
+, _rgb{}
+, _outputs{}
+, _outputCount{}
+, _frameCount{}
+, _dirty{}
+, _format{NIN_PIXEL_FORMAT_RGBA8888}
 , _frameChanged{}
+, _rgbStale{true}
+, _enabled{true}
+, _enabledNext{true}
 {
+    std::uint32_t color;
+    std::uint32_t c;
+    int r;
+    int g;
+    int b;
 
+    /* Each emphasis bit darkens the two other channels */
+    for (int e = 0; e < 8; ++e)
+    {
+        for (int i = 0; i < 64; ++i)
+        {
+            color = kPalette[i];
+            for (int ch = 0; ch < 3; ++ch)
+            {
+                c = (color >> (ch * 8)) & 0xff;
+                for (int bit = 0; bit < 3; ++bit)
+                {
+                    if (bit != ch && (e & (1 << bit)))
+                        c = c * 209 / 256;
+                }
+                color = (color & ~(0xffu << (ch * 8))) | (c << (ch * 8));
+            }
+            _palette[e * 64 + i] = color;
+
+            /* BT.601, limited range */
+            r = color & 0xff;
+            g = (color >> 8) & 0xff;
+            b = (color >> 16) & 0xff;
+            _paletteBGRA[e * 64 + i] = 0xff000000 | (r << 16) | (g << 8) | b;
+            _palette565[e * 64 + i] = std::uint16_t(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+            _paletteY[e * 64 + i] = std::uint8_t(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+            _paletteU[e * 64 + i] = std::uint8_t(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            _paletteV[e * 64 + i] = std::uint8_t(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+}
+
+const std::uint32_t* Video::front()
+{
+    if (_rgbStale)
+    {
+        convert(_rgb, NIN_PIXEL_FORMAT_RGBA8888);
+        _rgbStale = false;
+    }
+    return _rgb;
+}
+
+/*
+ * Must not race with acquire() or release(), the caller sets its buffers
+ * up before handing them to another thread.
+ */
+void Video::setOutputs(void* const* buffers, std::size_t count)
+{
+    _outputCount = (count < kMaxOutputs) ? count : kMaxOutputs;
+    for (std::size_t i = 0; i < _outputCount; ++i)
+    {
+        _outputs[i].buffer = buffers[i];
+        _outputs[i].seq.store(0, std::memory_order_relaxed);
+        _outputs[i].state.store(kOutputFree, std::memory_order_relaxed);
+    }
+}
+
+/*
+ * Hands the oldest finished frame to the caller, who owns it until it is
+ * released. Safe to call from another thread than the emulation.
+ */
+void* Video::acquire()
+{
+    Output* oldest;
+    std::uint64_t seq;
+    std::uint64_t oldestSeq;
+    std::uint8_t expected;
+
+    for (;;)
+    {
+        oldest = nullptr;
+        oldestSeq = 0;
+        for (std::size_t i = 0; i < _outputCount; ++i)
+        {
+            if (_outputs[i].state.load(std::memory_order_acquire) != kOutputReady)
+                continue;
+            seq = _outputs[i].seq.load(std::memory_order_relaxed);
+            if (!oldest || seq < oldestSeq)
+            {
+                oldest = _outputs + i;
+                oldestSeq = seq;
+            }
+        }
+        if (!oldest)
+            return nullptr;
+
+        /* The emulation may have reclaimed it in the meantime */
+        expected = kOutputReady;
+        if (oldest->state.compare_exchange_strong(expected, kOutputHeld, std::memory_order_acquire))
+            return oldest->buffer;
+    }
+}
+
+/*
+ * Reports the lines that changed between a frame and the one rendered
+ * before it, and returns the frame number. A gap in frame numbers means
+ * the caller missed a frame and has to assume everything changed.
+ */
+std::uint64_t Video::dirty(const void* buffer, std::uint8_t* dst) const
+{
+    if (!buffer)
+    {
+        std::memcpy(dst, _dirty, NIN_DIRTY_SIZE);
+        return _frameCount;
+    }
+    for (std::size_t i = 0; i < _outputCount; ++i)
+    {
+        if (_outputs[i].buffer == buffer)
+        {
+            std::memcpy(dst, _outputs[i].dirty, NIN_DIRTY_SIZE);
+            return _outputs[i].seq.load(std::memory_order_relaxed);
+        }
+    }
+    std::memset(dst, 0xff, NIN_DIRTY_SIZE);
+    return 0;
+}
+
+void Video::release(void* buffer)
+{
+    for (std::size_t i = 0; i < _outputCount; ++i)
+    {
+        if (_outputs[i].buffer == buffer)
+        {
+            _outputs[i].state.store(kOutputFree, std::memory_order_release);
+            return;
+        }
+    }
 }
 
 void Video::swap()
 {
-    std::uint32_t* tmp;
+    Frame* tmp;
 
-    tmp = _backBuffer;
-    _backBuffer = _frontBuffer;
-    _frontBuffer = tmp;
-    std::memset(_backBuffer, 0, sizeof(_buffer0));
+    /* A headless frame has no pixels, keep showing the last one we have */
     _frameChanged = true;
+    if (_enabled)
+    {
+        diff();
+
+        /* Every visible dot is written each frame, the back frame needs no clearing */
+        tmp = _back;
+        _back = _front;
+        _front = tmp;
+        _rgbStale = true;
+        _frameCount++;
+        if (_outputCount)
+            publish();
+    }
+
+    /* Toggling only takes effect on frame boundaries */
+    _enabled = _enabledNext;
+}
+
+/*
+ * Converts the frame straight into a free output buffer. When the caller
+ * lags behind, the oldest frame it did not acquire yet is overwritten, and
+ * when it holds every buffer the frame is dropped.
+ */
+void Video::publish()
+{
+    Output* out;
+    Output* oldest;
+    std::uint8_t state;
+    std::uint8_t expected;
+
+    for (;;)
+    {
+        out = nullptr;
+        oldest = nullptr;
+        for (std::size_t i = 0; i < _outputCount; ++i)
+        {
+            state = _outputs[i].state.load(std::memory_order_acquire);
+            if (state == kOutputFree)
+            {
+                out = _outputs + i;
+                break;
+            }
+            if (state == kOutputReady && (!oldest || _outputs[i].seq.load(std::memory_order_relaxed) < oldest->seq.load(std::memory_order_relaxed)))
+                oldest = _outputs + i;
+        }
+
+        /* Only the emulation takes free buffers, no need for a CAS */
+        if (out)
+        {
+            out->state.store(kOutputWriting, std::memory_order_relaxed);
+            break;
+        }
+        if (!oldest)
+            return;
+        expected = kOutputReady;
+        if (oldest->state.compare_exchange_strong(expected, kOutputWriting, std::memory_order_acquire))
+        {
+            out = oldest;
+            break;
+        }
+    }
+
+    convert(out->buffer, _format);
+    std::memcpy(out->dirty, _dirty, NIN_DIRTY_SIZE);
+    out->seq.store(_frameCount, std::memory_order_relaxed);
+    out->state.store(kOutputReady, std::memory_order_release);
+}
+
+/* Compares the finished frame against the one on display */
+void Video::diff()
+{
+    std::memset(_dirty, 0, NIN_DIRTY_SIZE);
+    for (int y = 0; y < 240; ++y)
+    {
+        if (_back->emphasis[y] != _front->emphasis[y] || std::memcmp(_back->pixels + y * 256, _front->pixels + y * 256, 256))
+            _dirty[y / 8] |= (1 << (y % 8));
+    }
+}
+
+void Video::convert(void* dst, NinPixelFormat format)
+{
+    switch (format)
+    {
+    case NIN_PIXEL_FORMAT_RGBA8888:
+        convert32((std::uint32_t*)dst, _palette);
+        break;
+    case NIN_PIXEL_FORMAT_BGRA8888:
+        convert32((std::uint32_t*)dst, _paletteBGRA);
+        break;
+    case NIN_PIXEL_FORMAT_RGB565:
+        convert16((std::uint16_t*)dst, _palette565);
+        break;
+    case NIN_PIXEL_FORMAT_YUV420:
+        convertYUV((std::uint8_t*)dst);
+        break;
+    }
+}
+
+void Video::convert32(std::uint32_t* dst, const std::uint32_t* palette)
+{
+    const std::uint8_t* src;
+    const std::uint32_t* pal;
+
+    src = _front->pixels;
+    for (int y = 0; y < 240; ++y)
+    {
+        pal = palette + _front->emphasis[y] * 64;
+        for (int x = 0; x < 256; ++x)
+            dst[x] = pal[src[x] & 0x3f];
+        src += 256;
+        dst += 256;
+    }
+}
+
+void Video::convert16(std::uint16_t* dst, const std::uint16_t* palette)
+{
+    const std::uint8_t* src;
+    const std::uint16_t* pal;
+
+    src = _front->pixels;
+    for (int y = 0; y < 240; ++y)
+    {
+        pal = palette + _front->emphasis[y] * 64;
+        for (int x = 0; x < 256; ++x)
+            dst[x] = pal[src[x] & 0x3f];
+        src += 256;
+        dst += 256;
+    }
+}
+
+/*
+ * Rounded average of a 2x2 block, taken as the average of the two rows and
+ * then of the two columns, so that the SSE2 path gives the same result.
+ */
+static void subsample(std::uint8_t* dst, const std::uint8_t* row0, const std::uint8_t* row1)
+{
+    int left;
+    int right;
+    int x;
+#if defined(__SSE2__)
+    __m128i mask;
+    __m128i a;
+    __m128i b;
+#endif
+
+    x = 0;
+#if defined(__SSE2__)
+    mask = _mm_set1_epi16(0x00ff);
+    for (; x < 256; x += 32)
+    {
+        a = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(row0 + x)), _mm_loadu_si128((const __m128i*)(row1 + x)));
+        b = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(row0 + x + 16)), _mm_loadu_si128((const __m128i*)(row1 + x + 16)));
+        a = _mm_avg_epu16(_mm_and_si128(a, mask), _mm_srli_epi16(a, 8));
+        b = _mm_avg_epu16(_mm_and_si128(b, mask), _mm_srli_epi16(b, 8));
+        _mm_storeu_si128((__m128i*)(dst + x / 2), _mm_packus_epi16(a, b));
+    }
+#endif
+    for (; x < 256; x += 2)
+    {
+        left = (row0[x + 0] + row1[x + 0] + 1) >> 1;
+        right = (row0[x + 1] + row1[x + 1] + 1) >> 1;
+        dst[x / 2] = std::uint8_t((left + right + 1) >> 1);
+    }
+}
+
+/* Planar Y, then U and V at half resolution */
+void Video::convertYUV(std::uint8_t* dst)
+{
+    std::uint8_t u[2][256];
+    std::uint8_t v[2][256];
+    const std::uint8_t* src;
+    std::uint8_t* planeY;
+    std::uint8_t* planeU;
+    std::uint8_t* planeV;
+    int e;
+
+    planeY = dst;
+    planeU = dst + 256 * 240;
+    planeV = planeU + 128 * 120;
+    src = _front->pixels;
+    for (int y = 0; y < 240; ++y)
+    {
+        e = _front->emphasis[y] * 64;
+        for (int x = 0; x < 256; ++x)
+        {
+            planeY[x] = _paletteY[e + (src[x] & 0x3f)];
+            u[y & 1][x] = _paletteU[e + (src[x] & 0x3f)];
+            v[y & 1][x] = _paletteV[e + (src[x] & 0x3f)];
+        }
+        if (y & 1)
+        {
+            subsample(planeU, u[0], u[1]);
+            subsample(planeV, v[0], v[1]);
+            planeU += 128;
+            planeV += 128;
+        }
+        src += 256;
+        planeY += 256;
+    }
 }
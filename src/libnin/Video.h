@@ -29,7 +29,10 @@
 #ifndef LIBNIN_VIDEO_H
 #define LIBNIN_VIDEO_H 1
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <nin/nin.h>
 #include <libnin/NonCopyable.h>
 
 namespace libnin
@@ -40,20 +43,77 @@ class Video : private NonCopyable
 public:
     Video();
 
-    const std::uint32_t* front() const { return _frontBuffer; }
+    const std::uint32_t* front();
 
-    void write(std::uint32_t pos, std::uint8_t color) { _backBuffer[pos] = kPalette[color]; }
+    void            setOutputs(void* const* buffers, std::size_t count);
+    void            setFormat(NinPixelFormat format) { _format = format; }
+    void            setEnabled(bool enabled) { _enabledNext = enabled; }
+    bool            enabled() const { return _enabled; }
+    void*           acquire();
+    void            release(void* buffer);
+    std::uint64_t   dirty(const void* buffer, std::uint8_t* dst) const;
+
+    void write(std::uint32_t pos, std::uint8_t color) { _back->pixels[pos] = color; }
+    void emphasis(std::uint8_t line, std::uint8_t bits) { _back->emphasis[line] = bits; }
     void swap();
     bool changed() { bool tmp = _frameChanged; _frameChanged = false; return tmp; }
 
 private:
     static const std::uint32_t kPalette[];
 
-    std::uint32_t   _buffer0[256 * 240];
-    std::uint32_t   _buffer1[256 * 240];
-    std::uint32_t*  _frontBuffer;
-    std::uint32_t*  _backBuffer;
-    bool            _frameChanged;
+    /* Frames are kept as palette indices, with the emphasis bits of each line */
+    struct Frame
+    {
+        std::uint8_t pixels[256 * 240];
+        std::uint8_t emphasis[240];
+    };
+
+    /* Caller-provided output buffers, handed between threads through their state */
+    enum : std::uint8_t
+    {
+        kOutputFree,
+        kOutputWriting,
+        kOutputReady,
+        kOutputHeld
+    };
+
+    struct Output
+    {
+        void*                       buffer;
+        std::atomic<std::uint64_t>  seq;
+        std::atomic<std::uint8_t>   state;
+        std::uint8_t                dirty[NIN_DIRTY_SIZE];
+    };
+
+    static constexpr const std::size_t kMaxOutputs = 8;
+
+    void convert(void* dst, NinPixelFormat format);
+    void convert32(std::uint32_t* dst, const std::uint32_t* palette);
+    void convert16(std::uint16_t* dst, const std::uint16_t* palette);
+    void convertYUV(std::uint8_t* dst);
+    void publish();
+    void diff();
+
+    /* Every color under each emphasis, in every output format */
+    std::uint32_t   _palette[8 * 64];
+    std::uint32_t   _paletteBGRA[8 * 64];
+    std::uint16_t   _palette565[8 * 64];
+    std::uint8_t    _paletteY[8 * 64];
+    std::uint8_t    _paletteU[8 * 64];
+    std::uint8_t    _paletteV[8 * 64];
+    Frame           _frames[2];
+    Frame*          _front;
+    Frame*          _back;
+    std::uint32_t   _rgb[256 * 240];
+    Output          _outputs[kMaxOutputs];
+    std::size_t     _outputCount;
+    std::uint64_t   _frameCount;
+    std::uint8_t    _dirty[NIN_DIRTY_SIZE];    /* Lines of the front frame that changed, one bit each */
+    NinPixelFormat  _format;
+    bool            _frameChanged:1;
+    bool            _rgbStale:1;
+    bool            _enabled:1;
+    bool            _enabledNext:1;
 };
 
 };
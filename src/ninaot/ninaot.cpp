@@ -0,0 +1,343 @@
+/*
+ * BSD 2 - Clause License
+ *
+ * Copyright(c) 2019, Maxime Bacoux
+ * All rights reserved.
+ *
+ * Redistributionand use in sourceand binary forms, with or without
+ * modification, are permitted provided that the following conditions are met :
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditionsand the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditionsand the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * ninaot - compile the PRG ROM code of a game into a libnin module
+ *
+ * Usage: ninaot <rom> <output.cpp> [frames]
+ *
+ * Code is traced from the reset, NMI and IRQ vectors, plus every PC hit while
+ * running the game for the given number of frames. Each basic block becomes a
+ * CPU::aot<addr> function chaining the fused instruction handlers. Build
+ * libnin with -DNIN_AOT_MODULE=<output.cpp> to use it: the CPU then runs on
+ * the fused core. Blocks are checked against the mapped bank when first
+ * executed, anything else runs one fused instruction at a time.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <set>
+#include <vector>
+#include <nin/nin.h>
+
+enum class Flow
+{
+    None,
+    Branch,
+    Jump,
+    JumpIndirect,
+    Call,
+    Return,
+    Stop
+};
+
+static int opLength(std::uint8_t op)
+{
+    int row;
+    int col;
+
+    row = op >> 4;
+    col = op & 0x0f;
+
+    switch (col)
+    {
+    case 0x0:
+        if (row & 1)
+            return 2;
+        if (op == 0x20)
+            return 3;
+        if (op == 0x00 || op == 0x40 || op == 0x60)
+            return 1;
+        return 2;
+    case 0x2:
+        if (!(row & 1) && row >= 0x8)
+            return 2;
+        return 1;
+    case 0x8:
+    case 0xa:
+        return 1;
+    case 0x9:
+    case 0xb:
+        return (row & 1) ? 3 : 2;
+    case 0xc:
+    case 0xd:
+    case 0xe:
+    case 0xf:
+        return 3;
+    default:
+        return 2;
+    }
+}
+
+static Flow opFlow(std::uint8_t op)
+{
+    if ((op & 0x1f) == 0x10)
+        return Flow::Branch;
+    switch (op)
+    {
+    case 0x4c:
+        return Flow::Jump;
+    case 0x6c:
+        return Flow::JumpIndirect;
+    case 0x20:
+        return Flow::Call;
+    case 0x40:
+    case 0x60:
+        return Flow::Return;
+    case 0x00:
+    case 0x02: case 0x12: case 0x22: case 0x32: case 0x42: case 0x52:
+    case 0x62: case 0x72: case 0x92: case 0xb2: case 0xd2: case 0xf2:
+        return Flow::Stop;
+    default:
+        return Flow::None;
+    }
+}
+
+/*
+ * Writes that may land on a register or switch banks end a block, so that
+ * the rest of the code is looked up again in whatever bank is now mapped.
+ */
+static bool opUnsafeWrite(std::uint8_t op, std::uint16_t operand)
+{
+    int row;
+    int col;
+    bool rmw;
+
+    row = op >> 4;
+    col = op & 0x0f;
+    switch (op)
+    {
+    case 0x81: case 0x83: case 0x84: case 0x85: case 0x86: case 0x87:
+    case 0x8c: case 0x8d: case 0x8e: case 0x8f: case 0x91: case 0x93:
+    case 0x94: case 0x95: case 0x96: case 0x97: case 0x99: case 0x9b:
+    case 0x9c: case 0x9d: case 0x9e: case 0x9f:
+        rmw = false;
+        break;
+    default:
+        rmw = (row < 0x8 || row >= 0xc) && (col == 0x3 || col == 0x6 || col == 0x7 || col == 0xe || col == 0xf || (col == 0xb && (row & 1)));
+        if (!rmw)
+            return false;
+    }
+
+    /* Zero page */
+    if (col >= 0x4 && col <= 0x7)
+        return false;
+
+    /* Absolute RAM */
+    if (!(row & 1) && col >= 0xc && operand < 0x2000)
+        return false;
+
+    return true;
+}
+
+struct Tracer
+{
+    std::uint8_t            mem[0x10000];
+    std::set<std::uint16_t> code;
+    std::set<std::uint16_t> leaders;
+
+    std::uint16_t operand(std::uint16_t addr) const
+    {
+        return mem[(addr + 1) & 0xffff] | (mem[(addr + 2) & 0xffff] << 8);
+    }
+
+    void trace(std::uint16_t entry)
+    {
+        std::vector<std::uint16_t> work;
+        std::uint16_t addr;
+        std::uint8_t op;
+        int len;
+
+        leaders.insert(entry);
+        work.push_back(entry);
+        while (!work.empty())
+        {
+            addr = work.back();
+            work.pop_back();
+            for (;;)
+            {
+                if (addr < 0x8000 || code.count(addr))
+                    break;
+                code.insert(addr);
+                op = mem[addr];
+                len = opLength(op);
+                switch (opFlow(op))
+                {
+                case Flow::Branch:
+                    push(work, std::uint16_t(addr + 2 + std::int8_t(mem[(addr + 1) & 0xffff])));
+                    push(work, std::uint16_t(addr + len));
+                    break;
+                case Flow::Call:
+                    push(work, operand(addr));
+                    push(work, std::uint16_t(addr + len));
+                    break;
+                case Flow::Jump:
+                    push(work, operand(addr));
+                    break;
+                case Flow::None:
+                    addr = std::uint16_t(addr + len);
+                    continue;
+                default:
+                    break;
+                }
+                break;
+            }
+        }
+    }
+
+    void push(std::vector<std::uint16_t>& work, std::uint16_t addr)
+    {
+        leaders.insert(addr);
+        work.push_back(addr);
+    }
+};
+
+static void emitBlock(std::FILE* f, const Tracer& t, std::uint16_t start, std::vector<std::uint16_t>& blocks)
+{
+    std::vector<std::uint16_t> instrs;
+    std::uint32_t addr;
+    std::uint32_t end;
+    std::uint8_t op;
+    int len;
+
+    addr = start;
+    for (;;)
+    {
+        op = t.mem[addr];
+        len = opLength(op);
+
+        /* Blocks must fit in the 8KiB bank they start in */
+        if ((addr & ~0x1fffu) != ((addr + len - 1) & ~0x1fffu) || addr + len > 0x10000)
+            break;
+        instrs.push_back(std::uint16_t(addr));
+        addr += len;
+        if (opFlow(op) != Flow::None || opUnsafeWrite(op, t.operand(std::uint16_t(addr - len))))
+            break;
+        if (addr >= 0x10000 || t.leaders.count(std::uint16_t(addr)) || !t.code.count(std::uint16_t(addr)))
+            break;
+    }
+    if (instrs.size() < 2)
+        return;
+    end = addr;
+
+    std::fprintf(f, "static const std::uint8_t kBlock%04X[] = {", start);
+    for (addr = start; addr < end; ++addr)
+        std::fprintf(f, "%s0x%02x", (addr == start) ? " " : ", ", t.mem[addr]);
+    std::fprintf(f, " };\n\n");
+
+    std::fprintf(f, "template<> CPU::Handler CPU::aot<0x%04x>(void)\n{\n", start);
+    std::fprintf(f, "    Handler next;\n\n");
+    for (std::size_t i = 0; i < instrs.size(); ++i)
+    {
+        if (i + 1 == instrs.size())
+        {
+            std::fprintf(f, "    return (this->*kFusedOps[0x%02x].p)();\n", t.mem[instrs[i]]);
+            break;
+        }
+        std::fprintf(f, "    next = (this->*kFusedOps[0x%02x].p)();\n", t.mem[instrs[i]]);
+        std::fprintf(f, "    if (!aotStep(next, kBlock%04X + %u)) return next;\n", start, unsigned(instrs[i + 1] - start + 1));
+    }
+    std::fprintf(f, "}\n\n");
+    blocks.push_back(start);
+    blocks.push_back(std::uint16_t(end - start));
+}
+
+int main(int argc, char** argv)
+{
+    static Tracer t;
+    NinState* state;
+    NinInt32 pc;
+    std::FILE* f;
+    std::vector<std::uint16_t> blocks;
+    long frames;
+
+    if (argc != 3 && argc != 4)
+    {
+        std::fprintf(stderr, "usage: %s <rom> <output.cpp> [frames]\n", argv[0]);
+        return 1;
+    }
+    frames = (argc == 4) ? std::strtol(argv[3], nullptr, 10) : 0;
+
+    if (ninCreateState(&state, argv[1]) != NIN_OK)
+    {
+        std::fprintf(stderr, "%s: could not load %s\n", argv[0], argv[1]);
+        return 1;
+    }
+
+    /* Runtime code log */
+    std::vector<std::uint16_t> hits;
+    while (frames > 0)
+    {
+        ninInfoQueryInteger(state, &pc, NIN_INFO_PC);
+        hits.push_back(std::uint16_t(pc));
+        if (ninStepInstruction(state))
+            frames--;
+    }
+
+    ninDumpMemory(state, t.mem, 0x0000, 0x10000);
+    ninDestroyState(state);
+
+    t.trace(t.operand(0xfffa - 1));
+    t.trace(t.operand(0xfffc - 1));
+    t.trace(t.operand(0xfffe - 1));
+    for (std::uint16_t addr : hits)
+    {
+        if (!t.code.count(addr))
+            t.trace(addr);
+    }
+
+    f = std::fopen(argv[2], "w");
+    if (!f)
+    {
+        std::fprintf(stderr, "%s: could not open %s\n", argv[0], argv[2]);
+        return 1;
+    }
+
+    std::fprintf(f, "/* Generated by ninaot from %s, do not edit */\n\n", argv[1]);
+    std::fprintf(f, "#include <libnin/CPU_impl.h>\n\n");
+    std::fprintf(f, "namespace libnin\n{\n\n");
+    for (std::uint16_t addr : t.leaders)
+    {
+        if (addr >= 0x8000 && t.code.count(addr))
+            emitBlock(f, t, addr, blocks);
+    }
+
+    std::fprintf(f, "const CPU::AotBlock CPU::kAotBlocks[] = {\n");
+    for (std::size_t i = 0; i < blocks.size(); i += 2)
+        std::fprintf(f, "    { 0x%04x, %u, kBlock%04X, &CPU::aot<0x%04x> },\n", blocks[i], blocks[i + 1], blocks[i], blocks[i]);
+    if (blocks.empty())
+        std::fprintf(f, "    { 0, 0, nullptr, nullptr },\n");
+    std::fprintf(f, "};\n\n");
+    std::fprintf(f, "const std::size_t CPU::kAotBlockCount = %u;\n\n", unsigned(blocks.size() / 2));
+    std::fprintf(f, "}\n");
+    std::fclose(f);
+
+    std::printf("%u blocks, %u instructions\n", unsigned(blocks.size() / 2), unsigned(t.code.size()));
+    return 0;
+}
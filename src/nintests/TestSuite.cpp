@@ -1,4 +1,5 @@
 #include <cstdio>
+#include <cstring>
 #include <thread>
 #include <nin/nin.h>
 #include "TestSuite.h"
@@ -121,27 +122,112 @@ void TestSuite::run_thread()
     }
 }
 
-void TestSuite::run_test(Test& t)
+namespace
 {
-    NinState* s;
 
-    if (ninCreateState(&s, t.path) != NIN_OK)
-    {
-        t.state = TestState::Error;
-        return;
-    }
+enum class VideoMode
+{
+    Enabled,
+    Disabled,
+    Toggled
+};
+
+struct RunMode
+{
+    std::uint32_t   flags;
+    VideoMode       video;
+};
 
-    ninRunCycles(s, t.cycles, nullptr);
+/* Everything a run must agree on with the sighted reference run */
+struct Snapshot
+{
+    NinInt32        regs[5];
+    std::uint8_t    ram[0x800];
+    std::uint8_t    sram[0x2000];
+    std::uint8_t    nametables[0x800];
 
-    if (t.pred(s))
+    void capture(NinState* state)
     {
-        t.state = TestState::Ok;
+        ninInfoQueryInteger(state, regs + 0, NIN_INFO_PC);
+        ninInfoQueryInteger(state, regs + 1, NIN_INFO_REG_A);
+        ninInfoQueryInteger(state, regs + 2, NIN_INFO_REG_X);
+        ninInfoQueryInteger(state, regs + 3, NIN_INFO_REG_Y);
+        ninInfoQueryInteger(state, regs + 4, NIN_INFO_REG_S);
+        ninDumpMemory(state, ram, 0x0000, sizeof(ram));
+        ninDumpMemory(state, sram, 0x6000, sizeof(sram));
+        ninDumpNametable(state, nametables, 0);
+        ninDumpNametable(state, nametables + 0x400, 1);
     }
-    else
+
+    bool operator==(const Snapshot& other) const
     {
-        t.state = TestState::Fail;
+        return std::memcmp(this, &other, sizeof(*this)) == 0;
     }
+};
+
+}
+
+void TestSuite::run_test(Test& t)
+{
+    static const RunMode kModes[] = {
+        { 0,                        VideoMode::Enabled },
+        { NIN_CREATE_LINE_CACHE,    VideoMode::Enabled },
+        { 0,                        VideoMode::Disabled },
+        { 0,                        VideoMode::Toggled },
+    };
+    NinState* s;
+    TestState result;
+    Snapshot reference;
+    Snapshot snapshot;
+    std::size_t third;
+
+    /*
+     * Every test must pass in each mode, and end in the same state as the
+     * first one. The toggled run switches video off and back on mid-frame,
+     * so the change has to wait for the next vblank.
+     */
+    result = TestState::Ok;
+    third = t.cycles / 3;
+    for (const RunMode& mode : kModes)
+    {
+        if (ninCreateStateEx(&s, t.path, mode.flags) != NIN_OK)
+        {
+            result = TestState::Error;
+            break;
+        }
 
-    ninDestroyState(s);
+        switch (mode.video)
+        {
+        case VideoMode::Enabled:
+            ninRunCycles(s, t.cycles, nullptr);
+            break;
+        case VideoMode::Disabled:
+            ninSetVideoEnabled(s, 0);
+            ninRunCycles(s, t.cycles, nullptr);
+            break;
+        case VideoMode::Toggled:
+            ninRunCycles(s, third, nullptr);
+            ninSetVideoEnabled(s, 0);
+            ninRunCycles(s, third, nullptr);
+            ninSetVideoEnabled(s, 1);
+            ninRunCycles(s, t.cycles - 2 * third, nullptr);
+            break;
+        }
+
+        if (!t.pred(s))
+            result = TestState::Fail;
+
+        if (&mode == kModes)
+            reference.capture(s);
+        else
+        {
+            snapshot.capture(s);
+            if (!(snapshot == reference))
+                result = TestState::Fail;
+        }
+
+        ninDestroyState(s);
+    }
+    t.state = result;
     _cv.notify_one();
 }
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
 #include <nin/nin.h>
 #include "TestSuite.h"
 
@@ -45,6 +48,102 @@ static bool matchHash(NinState* state, std::uint32_t expected)
     return (hash == expected);
 }
 
+static std::int16_t toInt16(float sample)
+{
+    sample *= 32767.f;
+    if (sample > 32767.f)
+        sample = 32767.f;
+    if (sample < -32768.f)
+        sample = -32768.f;
+    return std::int16_t(std::lrint(sample));
+}
+
+static void drainAudio(NinState* state)
+{
+    float tmp[1024];
+
+    while (ninAudioRead(state, tmp, 1024, NIN_AUDIO_FORMAT_FLOAT))
+        ;
+}
+
+/*
+ * Runs a second copy of the ROM alongside `state` to read the same samples
+ * in another format, or at another pace.
+ */
+static bool matchAudio(NinState* state, const char* path)
+{
+    static const std::uint32_t kFrequency = 44100;
+    static const std::size_t kRingSize = 16384;
+    NinState* twin;
+    NinInt32 clockRate;
+    std::size_t cycles;
+    std::size_t expected;
+    std::size_t count;
+    std::size_t twinCount;
+    bool ok;
+    bool sound;
+
+    std::vector<float> samples(kRingSize * 2);
+    std::vector<std::int16_t> samplesInt(kRingSize * 2);
+    std::vector<float> history;
+
+    if (ninCreateState(&twin, path) != NIN_OK)
+        return false;
+
+    ok = true;
+    sound = false;
+    ninInfoQueryInteger(state, &clockRate, NIN_INFO_CLOCK_RATE);
+    /* The test beeps around frame 20 */
+    for (NinState* s : { state, twin })
+    {
+        ninAudioSetFrequency(s, kFrequency);
+        ninAudioSetBlockSize(s, 1);
+        ninRunFrames(s, 8, nullptr);
+        drainAudio(s);
+    }
+
+    /*
+     * A few frames yield one sample per 1/kFrequency second, in whole blocks
+     * of NIN_AUDIO_BLOCK_MIN since smaller sizes are clamped.
+     */
+    ninRunFrames(state, 12, &cycles);
+    ninRunFrames(twin, 12, nullptr);
+    expected = std::size_t(std::uint64_t(cycles) * kFrequency / clockRate);
+    count = ninAudioRead(state, samples.data(), samples.size(), NIN_AUDIO_FORMAT_FLOAT);
+    twinCount = ninAudioRead(twin, samplesInt.data(), samplesInt.size(), NIN_AUDIO_FORMAT_INT16);
+    if (count != twinCount || count % NIN_AUDIO_BLOCK_MIN)
+        ok = false;
+    if (count + NIN_AUDIO_BLOCK_MIN < expected || count > expected + NIN_AUDIO_BLOCK_MIN)
+        ok = false;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        if (samplesInt[i] != toInt16(samples[i]))
+            ok = false;
+    }
+    sound = std::any_of(samples.begin(), samples.begin() + count, [](float f) { return f != 0.f; });
+
+    /* Left unread, the ring only keeps the newest samples */
+    for (int i = 0; i < 24; ++i)
+    {
+        ninRunFrames(twin, 1, nullptr);
+        count = ninAudioRead(twin, samples.data(), samples.size(), NIN_AUDIO_FORMAT_FLOAT);
+        history.insert(history.end(), samples.begin(), samples.begin() + count);
+    }
+    ninRunFrames(state, 24, nullptr);
+    count = ninAudioRead(state, samples.data(), samples.size(), NIN_AUDIO_FORMAT_FLOAT);
+    if (count != kRingSize || history.size() < kRingSize)
+        ok = false;
+    else if (!std::equal(samples.begin(), samples.begin() + count, history.end() - count))
+        ok = false;
+    else if (std::none_of(samples.begin(), samples.begin() + count, [](float f) { return f != 0.f; }))
+        sound = false;
+    if (ninAudioRead(state, samples.data(), samples.size(), NIN_AUDIO_FORMAT_FLOAT) != 0)
+        ok = false;
+
+    ninDestroyState(twin);
+    return ok && sound;
+}
+
 int main(void)
 {
     TestSuite suite;
@@ -91,5 +190,8 @@ int main(void)
     suite.add("Blargg Sprite Hit Tests - 10 Timing Order",  "blargg_sprite_hit_tests/10-timing_order.nes",     SEC_NTSC(1.50f), [](NinState* state) { return matchHash(state, 0x24ff7b4e); });
     suite.add("Blargg Sprite Hit Tests - 11 Edge Timing",   "blargg_sprite_hit_tests/11-edge_timing.nes",      SEC_NTSC(1.50f), [](NinState* state) { return matchHash(state, 0x7f6aa2ed); });
 
+    /* Audio */
+    suite.add("Audio - Read", "blargg_ppu_tests/1-palette_ram.nes", 0, [](NinState* state) { return matchAudio(state, "blargg_ppu_tests/1-palette_ram.nes"); });
+
     return suite.run();
 }
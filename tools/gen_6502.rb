@@ -122,6 +122,39 @@ class Rulebook
     a.join("")
   end
 
+  def emit_fused_op(op)
+    index = @ops[op]
+    if index == :kill
+      return "template<> CPU::Handler CPU::fused<#{"0x%03x" % op}>(void) { return &CPU::kil; }\n"
+    end
+
+    blocks = []
+    until index.nil?
+      step = @steps[index]
+      next_step = ref_step(step[1])
+      tail = "return next;"
+      unless step[1].nil?
+        check = "!fusedStep()"
+        if step[0].include?('RmwStore')
+          check = "!(next == Handler(#{next_step})) || " + check
+        end
+        tail = "if (#{check}) return next;"
+      end
+      blocks << ["    {", "Handler next = #{next_step};", *(step[0]), tail, "}"].join(" ")
+      index = step[1]
+    end
+    "template<> CPU::Handler CPU::fused<#{"0x%03x" % op}>(void)\n{\n#{blocks.join("\n")}\n}\n"
+  end
+
+  def emit_fused
+    @ops.keys.sort.map{|op| emit_fused_op(op)}.join("")
+  end
+
+  def emit_fused_ops
+    ops = @ops.keys.sort.map{|op| "&CPU::fused<#{"0x%03x" % op}>,"}.each_slice(4).map{|x| x.join(" ")}.map{|x| "    " + x}.join("\n")
+    "const CPU::Handler CPU::kFusedOps[] = {\n#{ops}\n};\n"
+  end
+
   def emit_ops
     ops = @ops.keys.sort.map{|op| ref_step(@ops[op]) + ","}.each_slice(4).map{|x| x.join(" ")}.map{|x| "    " + x}.join("\n")
     "const CPU::Handler CPU::kOps[] = {\n#{ops}\n};\n"
@@ -132,11 +165,116 @@ class Rulebook
     "const CPU::Handler CPU::kStates[] = {\n#{states}\n};\n"
   end
 
-  def emit_file(path)
+  def ref_id(step)
+    if step == :kill
+      'kStepKil'
+    elsif step.nil?
+      'kStepDispatch'
+    else
+      "kStepInstruction + #{"0x%03x" % step}"
+    end
+  end
+
+  def emit_step_body(index)
+    step = @steps[index]
+    "[this]() -> Step { #{["Step next = #{ref_id(step[1])};", *(step[0]), "return next;"].join(" ")} }()"
+  end
+
+  def emit_op_steps
+    ops = @ops.keys.sort.map{|op| ref_id(@ops[op]) + ","}.each_slice(4).map{|x| x.join(" ")}.map{|x| "    " + x}.join("\n")
+    "const CPU::Step CPU::kOpSteps[] = {\n#{ops}\n};\n"
+  end
+
+  # Every step becomes a case of a single switch, the loop of CPU::tick is
+  # inlined around it.
+  def emit_steps_switch
+    cases = @steps.keys.sort.map do |k|
+      "            case kStepInstruction + #{"0x%03x" % k}: step = #{emit_step_body(k)}; break;\n"
+    end
+    str = ""
+    str << "void CPU::runSteps()\n{\n"
+    str << "    Step step;\n\n"
+    str << "    step = _step;\n"
+    str << "    while (_cyclesLeft)\n    {\n"
+    str << "        if (_scheduler.due())\n            _scheduler.schedule();\n"
+    str << "        for (;;)\n        {\n"
+    str << "            switch (step)\n            {\n"
+    str << "            case kStepDispatch:\n"
+    str << "                step = dispatchStep();\n"
+    str << "                if (step >= kStepInstruction)\n                    continue;\n"
+    str << "                break;\n"
+    str << "            case kStepKil: break;\n"
+    str << "            case kStepHandler: step = stepOf((this->*_handler)()); break;\n"
+    str << cases.join("")
+    str << "            }\n"
+    str << "            break;\n"
+    str << "        }\n"
+    str << "        _odd = !_odd;\n"
+    str << "        _scheduler.advance();\n"
+    str << "        _cyclesLeft--;\n"
+    str << "    }\n"
+    str << "    _step = step;\n"
+    str << "}\n"
+    str
+  end
+
+  # Same as the switch, but every step jumps straight to the next one through
+  # its own indirect branch.
+  def emit_steps_goto
+    keys = @steps.keys.sort
+    labels = ['&&step_dispatch,', '&&step_kil,', '&&step_handler,'] + keys.map{|k| "&&step_#{"%03x" % k},"}
+    labels = labels.each_slice(4).map{|x| "        " + x.join(" ")}.join("\n")
+    advance = "_odd = !_odd; _scheduler.advance(); if (!--_cyclesLeft) goto done; if (_scheduler.due()) _scheduler.schedule(); goto *kLabels[step];"
+    str = ""
+    str << "void CPU::runSteps()\n{\n"
+    str << "    static const void* const kLabels[] = {\n#{labels}\n    };\n"
+    str << "    Step step;\n\n"
+    str << "    step = _step;\n"
+    str << "    if (!_cyclesLeft)\n        return;\n"
+    str << "    if (_scheduler.due())\n        _scheduler.schedule();\n"
+    str << "    goto *kLabels[step];\n\n"
+    str << "step_dispatch:\n"
+    str << "    step = dispatchStep();\n"
+    str << "    if (step >= kStepInstruction)\n        goto *kLabels[step];\n"
+    str << "    #{advance}\n"
+    str << "step_kil:\n"
+    str << "    #{advance}\n"
+    str << "step_handler:\n"
+    str << "    step = stepOf((this->*_handler)());\n"
+    str << "    #{advance}\n"
+    keys.each do |k|
+      str << "step_#{"%03x" % k}:\n"
+      str << "    step = #{emit_step_body(k)};\n"
+      str << "    #{advance}\n"
+    end
+    str << "done:\n"
+    str << "    _step = step;\n"
+    str << "}\n"
+    str
+  end
+
+  def emit_steps(dispatch)
+    str = ""
+    str << "#undef StateDispatch\n"
+    str << "#define StateDispatch       kStepDispatch\n"
+    str << "#undef StateWrite\n"
+    str << "#define StateWrite(a, v)    writeStep(a, v, next)\n"
+    str << "\n"
+    str << emit_op_steps
+    str << "\n"
+    str << (dispatch == 'goto' ? emit_steps_goto : emit_steps_switch)
+    str
+  end
+
+  def emit_file(path, dispatch)
     if @ops.size != 0x103
       raise StandardError, "Missing or extra ops"
     end
 
+    unless ['pointer', 'switch', 'goto'].include?(dispatch)
+      raise StandardError, "Unknown dispatch: #{dispatch}"
+    end
+
     File.open(path, "w") do |f|
       f.write "#include <libnin/CPU_impl.h>\n"
       f.write "#include <libnin/Memory.h>\n"
@@ -150,6 +288,14 @@ class Rulebook
       f.write "\n"
       f.write emit_states
       f.write "\n"
+      f.write emit_fused
+      f.write "\n"
+      f.write emit_fused_ops
+      f.write "\n"
+      if dispatch != 'pointer'
+        f.write emit_steps(dispatch)
+        f.write "\n"
+      end
       f.write "}\n"
       f.write "\n"
     end
@@ -473,4 +619,4 @@ end
 
 book.optimize
 
-book.emit_file ARGV[0]
+book.emit_file ARGV[0], (ARGV[1] || 'pointer')